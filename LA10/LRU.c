@@ -5,6 +5,9 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // System parameters
 const int PAGE_SIZE = 4096;                         
@@ -23,6 +26,8 @@ const int NFFMIN = 1000;
 typedef struct {
     uint16_t entry;      // Structure: Valid(15) | Ref(14) | FrameNum(0-13)
     uint16_t history;    // Tracks reference history for LRU approximation
+    bool shared;         // Mapped to the group's shared copy of the page
+    bool privatized;     // Page was copied on write; never remap the shared copy
 } PageTableEntry;
 
 // Frame list entry for managing free frames
@@ -37,7 +42,8 @@ typedef struct {
     int pid;              
     int s;                
     int m;                
-    int *keys;            
+    const char *keyPos;   // next unread key in the mapped search.txt
+    int key;              // key of the current (pending) search
     int currentSearch;    
     PageTableEntry *pt;   
     // Performance metrics
@@ -45,8 +51,22 @@ typedef struct {
     int pageFaults;
     int pageReplacements;
     int attemptCounts[4]; 
+    // NUMA placement
+    int homeNode;
+    int localAccesses;
+    int remoteAccesses;
+    // Shared array A
+    int group;
+    int softFaults;
+    int cowFaults;
 } Process;
 
+// Group-wide copy of one page of array A
+typedef struct {
+    int frame;           // -1 when not resident
+    int refs;            // processes currently mapping the frame
+} SharedPage;
+
 // Bit definitions for page table entries
 #define VALID_FLAG 0x8000    
 #define REF_FLAG   0x4000    
@@ -84,6 +104,9 @@ void invalidate(uint16_t *entry) {
 }
 
 // Global state
+const char *inputData;   // search.txt mapped read-only
+const char *inputEnd;
+size_t inputSize;
 FrameListEntry *freeFrames;
 Process **processes;
 int NFF = 0;
@@ -96,6 +119,31 @@ int totalPageFaults = 0;
 int totalPageReplacements = 0;
 int totalAttemptCounts[4] = {0};
 
+// Simulated NUMA topology: USER_FRAMES split into numaNodes consecutive ranges
+// whose sizes differ by at most one frame
+enum { NUMA_LOCAL, NUMA_INTERLEAVE, NUMA_PREFERRED };
+const char *numaPolicyNames[] = { "local", "interleave", "preferred" };
+int numaNodes = 1;
+int numaPolicy = NUMA_LOCAL;
+int preferredNode = 0;
+double remotePenalty = 2.0;     // cost of a remote access relative to a local one
+int framesPerNode;              // frames of the smaller nodes
+int largerNodes;                // the first largerNodes nodes hold one frame more
+int totalLocalAccesses = 0;
+int totalRemoteAccesses = 0;
+
+// Shared pages: processes pid / groupSize map one copy of array A,
+// and every writeEvery-th search writes A[L], copying the page on write
+int groupSize = 0;              // 0 disables sharing
+int writeEvery = 0;             // 0 keeps array A read-only
+SharedPage *sharedPages;        // PAGE_TABLE_ENTRIES entries per group
+int totalSoftFaults = 0;
+int totalCowFaults = 0;
+int framesSaved = 0;            // sum of refs - 1 over the resident shared frames
+int peakFramesSaved = 0;
+int sharedFrames = 0;           // resident frames mapped by more than one process
+int peakSharedFrames = 0;
+
 // Helper function to allocate and initialize memory
 void* safeAlloc(size_t size) {
     void* ptr = malloc(size);
@@ -107,21 +155,100 @@ void* safeAlloc(size_t size) {
     return ptr;
 }
 
+int frameNode(int frame) {
+    int largeFrames = largerNodes * (framesPerNode + 1);
+    if (frame < largeFrames) return frame / (framesPerNode + 1);
+    return largerNodes + (frame - largeFrames) / framesPerNode;
+}
+
+// Node the allocation policy wants the page placed on
+int targetNode(Process *proc, int vpage) {
+    switch (numaPolicy) {
+        case NUMA_INTERLEAVE: return vpage % numaNodes;
+        case NUMA_PREFERRED:  return preferredNode;
+        default:              return proc->homeNode;
+    }
+}
+
+// Scan the free list (from the back, or from the front if forward is set) for
+// a frame last owned by owner (-2 = anyone) holding page (-2 = any page).
+// A frame on node is preferred; otherwise the first match on any node is used.
+int scanFreeFrames(int owner, int page, int node, bool forward) {
+    int fallback = -1;
+    for (int k = 0; k < NFF; k++) {
+        int i = forward ? k : NFF - 1 - k;
+        if (owner != -2 && freeFrames[i].lastOwner != owner) continue;
+        if (page != -2 && freeFrames[i].lastPage != page) continue;
+        if (numaNodes == 1 || frameNode(freeFrames[i].frameNumber) == node) return i;
+        if (fallback < 0) fallback = i;
+    }
+    return fallback;
+}
+
+SharedPage *sharedPage(Process *proc, int vpage) {
+    return &sharedPages[proc->group * PAGE_TABLE_ENTRIES + vpage];
+}
+
+// Pages of array A are shared unless the process has its own copy
+bool isShareable(Process *proc, int vpage) {
+    return groupSize > 0 && vpage >= ESSENTIAL_PAGES && !proc->pt[vpage].privatized;
+}
+
+// Drop the process's reference to a shared frame.
+// Returns true if no other process maps it, i.e. the frame can be freed.
+bool unmapShared(Process *proc, int vpage) {
+    SharedPage *sp = sharedPage(proc, vpage);
+    proc->pt[vpage].shared = false;
+    if (--sp->refs > 0) {
+        framesSaved--;
+        if (sp->refs == 1) sharedFrames--;
+        return false;
+    }
+    sp->frame = -1;
+    return true;
+}
+
+// Evict a shared page from every process of the group that maps it,
+// so that its frame can be freed
+void evictShared(Process *proc, int vpage) {
+    SharedPage *sp = sharedPage(proc, vpage);
+    int first = proc->group * groupSize;
+    for (int i = first; i < first + groupSize && i < totalProcesses; i++) {
+        Process *other = processes[i];
+        if (!other->pt[vpage].shared) continue;
+        other->pt[vpage].shared = false;
+        invalidate(&other->pt[vpage].entry);
+    }
+    if (sp->refs > 1) {
+        framesSaved -= sp->refs - 1;
+        sharedFrames--;
+    }
+    sp->refs = 0;
+    sp->frame = -1;
+}
+
 // Initialize process data structure
 void initproc(Process *proc, int id, int size, int searches) {
     proc->pid = id;
     proc->s = size;
     proc->m = searches;
     proc->currentSearch = 0;
+    proc->homeNode = id % numaNodes;
+    proc->group = (groupSize > 0) ? id / groupSize : 0;
+    proc->keyPos = NULL;
+    proc->key = 0;
     
     // Allocate arrays
-    proc->keys = (int*)safeAlloc(searches * sizeof(int));
     proc->pt = (PageTableEntry*)safeAlloc(PAGE_TABLE_ENTRIES * sizeof(PageTableEntry));
     
     // Reset statistics counters
     proc->pageAccesses = 0;
     proc->pageFaults = 0;
     proc->pageReplacements = 0;
+    proc->localAccesses = 0;
+    proc->remoteAccesses = 0;
+    proc->softFaults = 0;
+    proc->cowFaults = 0;
     for (int i = 0; i < 4; i++) {
         proc->attemptCounts[i] = 0;
     }
@@ -138,10 +265,11 @@ void removeFreeFrameAt(int idx) {
 bool allocateFrame(Process *proc, int vpage) {
     if (NFF <= 0) return false;
     
-    int assignedFrame = freeFrames[0].frameNumber;
+    int idx = scanFreeFrames(-2, -2, targetNode(proc, vpage), true);
+    int assignedFrame = freeFrames[idx].frameNumber;
     
     // Remove from free list
-    removeFreeFrameAt(0);
+    removeFreeFrameAt(idx);
     
     // Update page table
     proc->pt[vpage].entry = makeEntry(assignedFrame, true);
@@ -166,6 +294,12 @@ void freeProcessFrames(Process *proc) {
         if (isValid(proc->pt[page].entry)) {
             int frame = getFrame(proc->pt[page].entry);
             
+            // Shared frames stay in use while other processes map them
+            if (proc->pt[page].shared && !unmapShared(proc, page)) {
+                invalidate(&proc->pt[page].entry);
+                continue;
+            }
+            
             // Add to free list
             freeFrames[NFF].frameNumber = frame;
             freeFrames[NFF].lastOwner = proc->pid;
@@ -179,20 +313,27 @@ void freeProcessFrames(Process *proc) {
 }
 
 int findVictimPage(Process *proc) {
-    int victim = -1;
-    uint16_t lowestUsage = 0xFFFF;
+    int victim = -1, sharedVictim = -1;
+    uint16_t lowestUsage = 0xFFFF, lowestSharedUsage = 0xFFFF;
     
-    // page with lowest history value (least recently used)
+    // page with lowest history value (least recently used); pages other
+    // processes also map are taken only if nothing else can be evicted,
+    // since evicting them unmaps the page from the whole group
     for (int page = ESSENTIAL_PAGES; page < PAGE_TABLE_ENTRIES; page++) {
         if (!isValid(proc->pt[page].entry)) continue;
         
-        if (proc->pt[page].history < lowestUsage) {
+        if (proc->pt[page].shared && sharedPage(proc, page)->refs > 1) {
+            if (proc->pt[page].history < lowestSharedUsage) {
+                lowestSharedUsage = proc->pt[page].history;
+                sharedVictim = page;
+            }
+        } else if (proc->pt[page].history < lowestUsage) {
             lowestUsage = proc->pt[page].history;
             victim = page;
         }
     }
     
-    return victim;
+    return (victim >= 0) ? victim : sharedVictim;
 }
 
 // Helper to print attempt details in verbose mode
@@ -221,45 +362,37 @@ int findSuitableFrame(Process *proc, int vpage) {
     int frameIndex = -1;
     int attemptUsed = -1;
     
+    int node = targetNode(proc, vpage);
+    
     // Attmept 1: frames that held the same page for this process
-    for (int i = NFF-1; i >= 0; i--) {
-        if (freeFrames[i].lastOwner == proc->pid && 
-            freeFrames[i].lastPage == vpage) {
-            frameIndex = i;
-            attemptUsed = 0;
-            p_Attempt(0, freeFrames[i].frameNumber, proc->pid, vpage);
-            break;
-        }
+    frameIndex = scanFreeFrames(proc->pid, vpage, node, false);
+    if (frameIndex != -1) {
+        attemptUsed = 0;
+        p_Attempt(0, freeFrames[frameIndex].frameNumber, proc->pid, vpage);
     }
     
     // Attmept 2: no previous owner
     if (frameIndex == -1) {
-        for (int i = NFF - 1; i >= 0; i--) {
-            if (freeFrames[i].lastOwner == -1) {
-                frameIndex = i;
-                attemptUsed = 1;
-                p_Attempt(1, freeFrames[i].frameNumber, -1, -1);
-                break;
-            }
+        frameIndex = scanFreeFrames(-1, -2, node, false);
+        if (frameIndex != -1) {
+            attemptUsed = 1;
+            p_Attempt(1, freeFrames[frameIndex].frameNumber, -1, -1);
         }
     }
     
     // Attmept 3: Try frames owned by same process
     if (frameIndex == -1) {
-        for (int i = NFF - 1; i >= 0; i--) {
-            if (freeFrames[i].lastOwner == proc->pid) {
-                frameIndex = i;
-                attemptUsed = 2;
-                p_Attempt(2, freeFrames[i].frameNumber, proc->pid, 
-                                 freeFrames[i].lastPage);
-                break;
-            }
+        frameIndex = scanFreeFrames(proc->pid, -2, node, false);
+        if (frameIndex != -1) {
+            attemptUsed = 2;
+            p_Attempt(2, freeFrames[frameIndex].frameNumber, proc->pid, 
+                             freeFrames[frameIndex].lastPage);
         }
     }
     
     // Attmept 4: Pick any random frame
     if (frameIndex == -1) {
-        frameIndex = 0; // Randomly select the first frame
+        frameIndex = scanFreeFrames(-2, -2, node, true); // first frame, on the target node if possible
         attemptUsed = 3;
         p_Attempt(3, freeFrames[frameIndex].frameNumber, 
                          freeFrames[frameIndex].lastOwner,
@@ -315,6 +448,12 @@ bool handlePageFault(Process *proc, int vpage) {
     }
     
     int victimFrame = getFrame(proc->pt[victimPage].entry);
+    if (proc->pt[victimPage].shared) evictShared(proc, victimPage);
+    
+    if (NFF == 0) {
+        fprintf(stderr, "Error: No free frame left for replacement\n");
+        return false;
+    }
     
     #ifdef VERBOSE
     printf("To replace Page %3d at Frame %d [history = %d]\n",
@@ -339,6 +478,77 @@ bool handlePageFault(Process *proc, int vpage) {
     return true;
 }
 
+// Reference one page; a write to a page shared with other processes copies it
+bool accessPage(Process *proc, int vpage, bool write) {
+    proc->pageAccesses++;
+    totalPageAccesses++;
+    
+    // Check if page is in memory
+    if (isValid(proc->pt[vpage].entry)) {
+        // Page in memory, mark as referenced
+        setReferenced(&proc->pt[vpage].entry);
+    } else if (isShareable(proc, vpage) && sharedPage(proc, vpage)->frame >= 0) {
+        // Another process of the group has the page: map its frame
+        SharedPage *sp = sharedPage(proc, vpage);
+        proc->pt[vpage].entry = makeEntry(sp->frame, true);
+        proc->pt[vpage].history = 0xFFFF;
+        proc->pt[vpage].shared = true;
+        sp->refs++;
+        proc->softFaults++;
+        totalSoftFaults++;
+        if (++framesSaved > peakFramesSaved) peakFramesSaved = framesSaved;
+        if (sp->refs == 2 && ++sharedFrames > peakSharedFrames) peakSharedFrames = sharedFrames;
+        #ifdef VERBOSE
+        printf("    Fault on Page %4d: Shared frame %d mapped\n", vpage, sp->frame);
+        #endif
+    } else {
+        // Handle page fault
+        if (!handlePageFault(proc, vpage)) {
+            return false;
+        }
+        if (isShareable(proc, vpage)) {
+            SharedPage *sp = sharedPage(proc, vpage);
+            sp->frame = getFrame(proc->pt[vpage].entry);
+            sp->refs = 1;
+            proc->pt[vpage].shared = true;
+        }
+    }
+    
+    if (write && proc->pt[vpage].shared) {
+        SharedPage *sp = sharedPage(proc, vpage);
+        proc->pt[vpage].privatized = true;
+        if (sp->refs == 1) {
+            // Sole user: take the frame over, nothing to copy
+            sp->frame = -1;
+            sp->refs = 0;
+            proc->pt[vpage].shared = false;
+        } else {
+            // Copy on write into a private frame
+            proc->cowFaults++;
+            totalCowFaults++;
+            #ifdef VERBOSE
+            printf("    Write on Page %4d: copying shared frame %d\n", vpage, sp->frame);
+            #endif
+            unmapShared(proc, vpage);
+            invalidate(&proc->pt[vpage].entry);
+            if (!handlePageFault(proc, vpage)) {
+                return false;
+            }
+        }
+    }
+    
+    // Account for where the page landed
+    if (frameNode(getFrame(proc->pt[vpage].entry)) == proc->homeNode) {
+        proc->localAccesses++;
+        totalLocalAccesses++;
+    } else {
+        proc->remoteAccesses++;
+        totalRemoteAccesses++;
+    }
+    
+    return true;
+}
+
 // Simulate binary search with page replacement
 bool binarySearch(Process *proc, int k) {
     int L = 0;
@@ -351,18 +561,8 @@ bool binarySearch(Process *proc, int k) {
         int pageOffset = arrayOffset / INTS_PER_PAGE;
         int vpage = ESSENTIAL_PAGES + pageOffset; // virtual page number
         
-        proc->pageAccesses++;
-        totalPageAccesses++;
-        
-        // Check if page is in memory
-        if (!isValid(proc->pt[vpage].entry)) {
-            // Handle page fault
-            if (!handlePageFault(proc, vpage)) {
-                return false;
-            }
-        } else {
-            // Page in memory, mark as referenced
-            setReferenced(&proc->pt[vpage].entry);
+        if (!accessPage(proc, vpage, false)) {
+            return false;
         }
         
         // Continue binary search
@@ -373,20 +573,90 @@ bool binarySearch(Process *proc, int k) {
         }
     }
     
+    // Every writeEvery-th search updates the element it found
+    if (writeEvery > 0 && (proc->currentSearch + 1) % writeEvery == 0) {
+        if (!accessPage(proc, ESSENTIAL_PAGES + L / INTS_PER_PAGE, true)) {
+            return false;
+        }
+    }
+    
     // Update page reference history after search completes
     updatePageHistory(proc);
     return true;
 }
 
-// Read input data from file
+// Skip blanks and parse one non-negative integer from the mapped input.
+// Digits are converted eight bytes at a time (SWAR) when enough input remains.
+bool parseInt(const char **pos, int *value) {
+    const char *p = *pos;
+    while (p < inputEnd && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (inputEnd - p >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, p, 8);
+        uint64_t digits = chunk - 0x3030303030303030ULL;
+        uint64_t nonDigit = (digits | (digits + 0x0606060606060606ULL)) & 0xF0F0F0F0F0F0F0F0ULL;
+        int len = nonDigit ? __builtin_ctzll(nonDigit) / 8 : 8;
+        if (len == 0) return false;
+        if (len < 8) {
+            digits <<= (8 - len) * 8;
+            digits = (digits * 10 + (digits >> 8)) & 0x00FF00FF00FF00FFULL;
+            digits = (digits * 100 + (digits >> 16)) & 0x0000FFFF0000FFFFULL;
+            digits = (digits * 10000 + (digits >> 32)) & 0xFFFFFFFFULL;
+            *value = (int)digits;
+            *pos = p + len;
+            return true;
+        }
+    }
+#endif
+
+    if (p >= inputEnd || *p < '0' || *p > '9') return false;
+    int result = 0;
+    while (p < inputEnd && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    *value = result;
+    *pos = p;
+    return true;
+}
+
+// Fetch the key of the next search of a process from its line in search.txt
+void nextKey(Process *proc) {
+    if (proc->currentSearch >= proc->m) return;
+    if (!parseInt(&proc->keyPos, &proc->key)) {
+        fprintf(stderr, "Error reading search key %d for process %d\n",
+                proc->currentSearch, proc->pid);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Map search.txt and set up the processes. Only the array sizes are parsed
+// here; the search keys stay in the mapping and are read one at a time.
 void readinput() {
-    FILE *input;
-    if ((input = fopen("search.txt", "r")) == NULL) {
+    int fd = open("search.txt", O_RDONLY);
+    if (fd < 0) {
         perror("Cannot open search.txt");
         exit(EXIT_FAILURE);
     }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "Error reading process count and search count\n");
+        exit(EXIT_FAILURE);
+    }
+    inputSize = (size_t)st.st_size;
+    inputData = (const char*)mmap(NULL, inputSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (inputData == MAP_FAILED) {
+        perror("Cannot map search.txt");
+        exit(EXIT_FAILURE);
+    }
+    inputEnd = inputData + inputSize;
     
-    if (fscanf(input, "%d %d", &totalProcesses, &searchesPerProcess) != 2) {
+    const char *pos = inputData;
+    if (!parseInt(&pos, &totalProcesses) || !parseInt(&pos, &searchesPerProcess)) {
         fprintf(stderr, "Error reading process count and search count\n");
         exit(EXIT_FAILURE);
     }
@@ -396,7 +666,7 @@ void readinput() {
     // Read each process data
     for (int i = 0; i < totalProcesses; i++) {
         int arraySize;
-        if (fscanf(input, "%d", &arraySize) != 1) {
+        if (!parseInt(&pos, &arraySize)) {
             fprintf(stderr, "Error reading array size for process %d\n", i);
             exit(EXIT_FAILURE);
         }
@@ -404,13 +674,11 @@ void readinput() {
         Process *proc = (Process*)safeAlloc(sizeof(Process));
         initproc(proc, i, arraySize, searchesPerProcess);
         
-        // Read search keys
-        for (int j = 0; j < searchesPerProcess; j++) {
-            if (fscanf(input, "%d", &proc->keys[j]) != 1) {
-                fprintf(stderr, "Error reading search key %d for process %d\n", j, i);
-                exit(EXIT_FAILURE);
-            }
-        }
+        // Keys follow on the same line; remember where and skip to the next line
+        proc->keyPos = pos;
+        nextKey(proc);
+        const char *eol = (const char*)memchr(pos, '\n', inputEnd - pos);
+        pos = eol ? eol + 1 : inputEnd;
         
         // Allocate essential pages
         if (!allocateEssentialPages(proc)) {
@@ -420,8 +688,6 @@ void readinput() {
         
         processes[i] = proc;
     }
-    
-    fclose(input);
 }
 
 // statistics for a single process
@@ -462,23 +728,91 @@ void printTotalStatistics() {
            totalAttemptCounts[0], totalAttemptCounts[1], 
            totalAttemptCounts[2], totalAttemptCounts[3],
            attemptPercent[0], attemptPercent[1], attemptPercent[2], attemptPercent[3]);
+    
+    if (groupSize > 0) {
+        float softPercent = (totalPageAccesses > 0) ? (totalSoftFaults * 100.0f) / totalPageAccesses : 0;
+        printf("    Shared    groups of %d: %d soft faults (%5.2f%%), %d copy-on-write faults, "
+               "frames saved = %d (%.2f MB) at peak, %d frames shared at peak\n",
+               groupSize, totalSoftFaults, softPercent, totalCowFaults,
+               peakFramesSaved, peakFramesSaved * (PAGE_SIZE / 1048576.0), peakSharedFrames);
+    }
+}
+
+// Local vs remote accesses per process, printed only when NUMA is simulated
+void printNumaStatistics() {
+    printf("\n+++ NUMA access summary (%d nodes, %s policy, remote penalty %.2f)\n",
+           numaNodes, numaPolicyNames[numaPolicy], remotePenalty);
+    printf("    PID   Node      Local          Remote        Access cost\n");
+    
+    for (int i = 0; i < totalProcesses; i++) {
+        Process *proc = processes[i];
+        float localPercent = (proc->pageAccesses > 0) ? (proc->localAccesses * 100.0f) / proc->pageAccesses : 0;
+        double cost = proc->localAccesses + proc->remoteAccesses * remotePenalty;
+        printf("    %-3d   %3d    %5d (%6.2f%%)  %5d (%6.2f%%)    %10.1f\n",
+               proc->pid, proc->homeNode, proc->localAccesses, localPercent,
+               proc->remoteAccesses, 100.0f - localPercent, cost);
+    }
+    
+    float localPercent = (totalPageAccesses > 0) ? (totalLocalAccesses * 100.0f) / totalPageAccesses : 0;
+    double cost = totalLocalAccesses + totalRemoteAccesses * remotePenalty;
+    printf("\n    Total        %6d (%6.2f%%) %6d (%6.2f%%)    %10.1f (%.3f per access)\n",
+           totalLocalAccesses, localPercent, totalRemoteAccesses, 100.0f - localPercent,
+           cost, (totalPageAccesses > 0) ? cost / totalPageAccesses : 0.0);
 }
 
 // Clean up all allocated memory
 void cleanup() {
     for (int i = 0; i < totalProcesses; i++) {
-        free(processes[i]->keys);
         free(processes[i]->pt);
         free(processes[i]);
     }
     free(processes);
     free(freeFrames);
+    free(sharedPages);
+    munmap((void*)inputData, inputSize);
 }
 
 // Main execution function
-int main() {
+int main(int argc, char *argv[]) {
     srand((unsigned int)time(NULL) * getpid());
     
+    // NUMA options: -n nodes, -p local|interleave|preferred, -P preferred node, -r remote penalty
+    // Sharing options: -g processes per group sharing array A, -w write every k-th search
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:P:r:g:w:")) != -1) {
+        switch (opt) {
+            case 'n': numaNodes = atoi(optarg); break;
+            case 'p':
+                numaPolicy = -1;
+                for (int i = 0; i < 3; i++) {
+                    if (strcmp(optarg, numaPolicyNames[i]) == 0) numaPolicy = i;
+                }
+                if (numaPolicy < 0) {
+                    fprintf(stderr, "Unknown NUMA policy %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P': preferredNode = atoi(optarg); break;
+            case 'r': remotePenalty = atof(optarg); break;
+            case 'g': groupSize = atoi(optarg); break;
+            case 'w': writeEvery = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-n nodes] [-p local|interleave|preferred] [-P node] [-r penalty] "
+                        "[-g group size] [-w write interval]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (numaNodes < 1 || numaNodes > USER_FRAMES || preferredNode < 0 || preferredNode >= numaNodes) {
+        fprintf(stderr, "Invalid NUMA configuration\n");
+        return EXIT_FAILURE;
+    }
+    if (writeEvery > 0 && groupSize == 0) {
+        fprintf(stderr, "-w writes to shared pages; give the group size with -g\n");
+        return EXIT_FAILURE;
+    }
+    framesPerNode = USER_FRAMES / numaNodes;
+    largerNodes = USER_FRAMES % numaNodes;
+    
     // Set up free frame list
     freeFrames = (FrameListEntry*)safeAlloc(USER_FRAMES * sizeof(FrameListEntry));
     for (int i = 0; i < USER_FRAMES; i++) {
@@ -490,6 +824,14 @@ int main() {
     
     // Read and process input data
     readinput();
+    
+    if (groupSize > 0) {
+        int groups = (totalProcesses + groupSize - 1) / groupSize;
+        sharedPages = (SharedPage*)safeAlloc((size_t)groups * PAGE_TABLE_ENTRIES * sizeof(SharedPage));
+        for (int i = 0; i < groups * PAGE_TABLE_ENTRIES; i++) {
+            sharedPages[i].frame = -1;
+        }
+    }
 
     /**** Round-robin execution of processes ****/
     int finishedProcesses = 0;
@@ -504,7 +846,7 @@ int main() {
             continue;
         }
         
-        int searchKey = proc->keys[proc->currentSearch];
+        int searchKey = proc->key;
         
         #ifdef VERBOSE
         printf("+++ Process %d: Search %d\n", proc->pid, proc->currentSearch + 1);
@@ -512,6 +854,7 @@ int main() {
         
         if (binarySearch(proc, searchKey)) {
             proc->currentSearch++;
+            nextKey(proc);
             
             // Check if process has completed all searches
             if (proc->currentSearch >= proc->m) {
@@ -535,6 +878,9 @@ int main() {
     }
     
     printTotalStatistics();
+    if (numaNodes > 1) {
+        printNumaStatistics();
+    }
     
     // Free all allocated memory
     cleanup();
@@ -1,26 +1,205 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/*
+   Usage: gensearch [n [m]] [-s seed] [-t threads] [-z theta]
+
+   Every line of search.txt has a fixed width ("%-10d " followed by m fields
+   "%-7d" and a separator), so line i starts at a known offset and each
+   thread can generate and pwrite() its own block of processes. All random
+   numbers of process i come from a SplitMix64 stream keyed by (seed, i),
+   which makes the file depend only on n, m, seed and theta and not on the
+   number of threads. With theta > 0 the keys follow a Zipf distribution
+   (key 0 the most popular) instead of the uniform one.
+*/
+
+#define BUFSIZE (4 << 20)
+
+int n, m, nthreads;
+uint64_t seed;
+double theta;
+int fd;
+off_t hdrlen, linelen;
+
+typedef struct {
+   int first, last;
+} block_t;
+
+static uint64_t mix64 ( uint64_t z )
+{
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+   return z ^ (z >> 31);
+}
+
+static uint64_t next64 ( uint64_t *state )
+{
+   *state += 0x9E3779B97F4A7C15ULL;
+   return mix64(*state);
+}
+
+static double nextdbl ( uint64_t *state )
+{
+   return (next64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Zipf sampling over 1..N by rejection-inversion (Hormann and Derflinger) */
+typedef struct {
+   double N, hx1, hN, s;
+} zipf_t;
+
+static double helper1 ( double x )   /* log1p(x) / x */
+{
+   return (fabs(x) > 1e-8) ? log1p(x) / x : 1.0 - x / 2.0;
+}
+
+static double helper2 ( double x )   /* expm1(x) / x */
+{
+   return (fabs(x) > 1e-8) ? expm1(x) / x : 1.0 + x / 2.0;
+}
+
+static double zh ( double x ) { return exp(-theta * log(x)); }
+static double zH ( double x ) { double l = log(x); return helper2((1.0 - theta) * l) * l; }
+static double zHinv ( double x )
+{
+   double t = x * (1.0 - theta);
+   if (t < -1.0) t = -1.0;   /* rounding near the ends of the range; log1p(t) is NaN below -1 */
+   return exp(helper1(t) * x);
+}
+
+static void zipfinit ( zipf_t *z, int N )
+{
+   z->N = N;
+   z->hx1 = zH(1.5) - 1.0;
+   z->hN = zH(N + 0.5);
+   z->s = 2.0 - zHinv(zH(2.5) - zh(2.0));
+}
+
+static int zipfnext ( zipf_t *z, uint64_t *state )
+{
+   while (1) {
+      double u = z->hN + nextdbl(state) * (z->hx1 - z->hN);
+      double x = zHinv(u);
+      double k = floor(x + 0.5);
+      if (k < 1) k = 1;
+      else if (k > z->N) k = z->N;
+      if (k - x <= z->s || u >= zH(k + 0.5) - zh(k)) return (int)k;
+   }
+}
+
+/* Write v left-justified in a field of the given width */
+static char *putfield ( char *p, unsigned v, int width )
+{
+   char tmp[12];
+   int len = 0, i;
+
+   do { tmp[len++] = '0' + v % 10; v /= 10; } while (v);
+   for (i=0; i<len; ++i) p[i] = tmp[len-1-i];
+   for (; i<width; ++i) p[i] = ' ';
+   return p + width;
+}
+
+static void genline ( int i, char *p )
+{
+   uint64_t state = mix64(seed ^ mix64((uint64_t)i + 1));
+   int s, j;
+   zipf_t z = { 0, 0, 0, 0 };
+
+   s = 1000000 + next64(&state) % 1000001;
+   p = putfield(p, s, 10);
+   if (m == 0) { *p = '\n'; return; }
+   *p++ = ' ';
+   if (theta > 0) zipfinit(&z, s);
+   for (j=0; j<m; ++j) {
+      unsigned k = (theta > 0) ? (unsigned)zipfnext(&z, &state) - 1 : (unsigned)(next64(&state) % s);
+      p = putfield(p, k, 7);
+      *p++ = (j == m-1) ? '\n' : ' ';
+   }
+}
+
+static void flush ( char *buf, size_t len, off_t off )
+{
+   size_t done = 0;
+   while (done < len) {
+      ssize_t w = pwrite(fd, buf + done, len - done, off + done);
+      if (w < 0) { perror("search.txt"); exit(1); }
+      done += w;
+   }
+}
+
+static void *genblock ( void *arg )
+{
+   block_t *b = (block_t *)arg;
+   size_t cap = (linelen > BUFSIZE) ? linelen : BUFSIZE;
+   char *buf = (char *)malloc(cap);
+   size_t used = 0;
+   off_t off = hdrlen + b->first * linelen;
+   int i;
+
+   if (buf == NULL) { fprintf(stderr, "Out of memory\n"); exit(1); }
+   for (i=b->first; i<b->last; ++i) {
+      if (used + linelen > cap) {
+         flush(buf, used, off);
+         off += used; used = 0;
+      }
+      genline(i, buf + used);
+      used += linelen;
+   }
+   flush(buf, used, off);
+   free(buf);
+   return NULL;
+}
 
 int main ( int argc, char *argv[] )
 {
-   int n, m, s, i, j;
-   FILE *fp;
+   int c, t, given = 0;
+   char hdr[32];
+   pthread_t *tid;
+   block_t *blk;
 
-   srand((unsigned int)time(NULL));
+   seed = (uint64_t)time(NULL);
+   nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   theta = 0;
+   while ((c = getopt(argc, argv, "s:t:z:")) != -1) {
+      switch (c) {
+         case 's': seed = strtoull(optarg, NULL, 10); given = 1; break;
+         case 't': nthreads = atoi(optarg); break;
+         case 'z': theta = atof(optarg); break;
+         default:
+            fprintf(stderr, "Usage: %s [n [m]] [-s seed] [-t threads] [-z theta]\n", argv[0]);
+            exit(1);
+      }
+   }
+   n = (optind >= argc) ? 200 : atoi(argv[optind]);
+   m = (optind + 1 >= argc) ? 100 : atoi(argv[optind+1]);
+   if (nthreads < 1) nthreads = 1;
+   if (nthreads > n) nthreads = (n > 0) ? n : 1;
+   if (!given) fprintf(stderr, "gensearch: seed = %llu\n", (unsigned long long)seed);
 
-   n = (argc == 1) ? 200 : atoi(argv[1]);
-   m = (argc <= 2) ? 100 : atoi(argv[2]);
+   fd = open("search.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0) { perror("search.txt"); exit(1); }
+   hdrlen = sprintf(hdr, "%d %d\n", n, m);
+   linelen = 11 + (m ? 8 * (off_t)m : 0);
+   flush(hdr, hdrlen, 0);
 
-   fp = (FILE *)fopen("search.txt", "w");
-   fprintf(fp, "%d %d\n", n, m);
-   for (i=0; i<n; ++i) {
-      s = 1000000 + rand() % 1000001;
-      fprintf(fp, "%-10d ", s);
-      for (j=0; j<m; ++j)
-         fprintf(fp, "%-7d%c", rand() % s, (j == m-1) ? '\n' : ' ');
+   tid = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+   blk = (block_t *)malloc(nthreads * sizeof(block_t));
+   for (t=0; t<nthreads; ++t) {
+      blk[t].first = (int)((long long)n * t / nthreads);
+      blk[t].last = (int)((long long)n * (t + 1) / nthreads);
+      pthread_create(&tid[t], NULL, genblock, &blk[t]);
    }
-   fclose(fp);
+   for (t=0; t<nthreads; ++t) pthread_join(tid[t], NULL);
+   close(fd);
 
+   free(tid);
+   free(blk);
    exit(0);
 }
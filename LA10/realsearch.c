@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+/*
+ * Companion to LRU.c: replays the binary searches of search.txt against real
+ * memory. Array A of every process is an anonymous mmap region and A[i] = i
+ * is written when a page is first loaded. The frame budget and the LRU
+ * replacement decisions are the same as in the simulator, but an evicted page
+ * is handed back to the kernel with madvise(), and the faults the kernel
+ * actually takes are read from getrusage() and compared with the simulated
+ * page fault count. Whether a page the model still holds was swapped out is
+ * checked with mincore() on every -c'th access to a written page; the checks
+ * are timed apart from the replay.
+ *
+ * Usage: realsearch [-a pageout|cold|dontneed] [-c check interval]
+ */
+
+// System parameters (as in LRU.c)
+const int PAGE_SIZE = 4096;
+const int USER_FRAMES = (64 - 16) * 1024 * 1024 / 4096;
+const int INTS_PER_PAGE = 4096 / sizeof(int);
+const int ESSENTIAL_PAGES = 10;
+const int NFFMIN = 1000;
+
+typedef struct {
+    int pid;
+    int s;
+    int m;
+    const char *keyPos;
+    int currentSearch;
+    int *A;               // the real array
+    size_t mapLength;
+    int pages;            // pages spanned by A
+    int resident;         // pages the model holds in frames
+    bool *inMemory;       // per page: held in a frame in the model
+    bool *populated;      // per page: contents written since last discarded
+    bool *referenced;
+    uint16_t *history;
+} Process;
+
+enum { ADV_PAGEOUT, ADV_COLD, ADV_DONTNEED };
+const char *adviceNames[] = { "pageout", "cold", "dontneed" };
+
+const char *inputData;
+const char *inputEnd;
+size_t inputSize;
+Process *processes;
+int totalProcesses, searchesPerProcess;
+int NFF;
+int advice = ADV_PAGEOUT;
+
+long simAccesses = 0, simFaults = 0, simReplacements = 0;
+int checkEvery = 64;    // -c: mincore() on every checkEvery-th access to a written page, 0 never
+long writtenAccesses = 0, residencyChecks = 0;
+long notResident = 0;   // checked accesses that mincore() reports not resident
+double checkSeconds = 0;
+volatile int sink;
+
+void *safeAlloc(size_t size) {
+    void *ptr = calloc(1, size);
+    if (!ptr) {
+        fprintf(stderr, "Fatal error: Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+bool parseInt(const char **pos, int *value) {
+    const char *p = *pos;
+    while (p < inputEnd && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    if (p >= inputEnd || *p < '0' || *p > '9') return false;
+    int result = 0;
+    while (p < inputEnd && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    *value = result;
+    *pos = p;
+    return true;
+}
+
+void readinput() {
+    int fd = open("search.txt", O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror("Cannot open search.txt");
+        exit(EXIT_FAILURE);
+    }
+    inputSize = (size_t)st.st_size;
+    inputData = (const char*)mmap(NULL, inputSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (inputData == MAP_FAILED) {
+        perror("Cannot map search.txt");
+        exit(EXIT_FAILURE);
+    }
+    inputEnd = inputData + inputSize;
+
+    const char *pos = inputData;
+    if (!parseInt(&pos, &totalProcesses) || !parseInt(&pos, &searchesPerProcess)) {
+        fprintf(stderr, "Error reading process count and search count\n");
+        exit(EXIT_FAILURE);
+    }
+
+    processes = (Process*)safeAlloc(totalProcesses * sizeof(Process));
+    for (int i = 0; i < totalProcesses; i++) {
+        Process *proc = &processes[i];
+        if (!parseInt(&pos, &proc->s)) {
+            fprintf(stderr, "Error reading array size for process %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+        proc->pid = i;
+        proc->m = searchesPerProcess;
+        proc->keyPos = pos;
+        const char *eol = (const char*)memchr(pos, '\n', inputEnd - pos);
+        pos = eol ? eol + 1 : inputEnd;
+
+        proc->pages = (proc->s + INTS_PER_PAGE - 1) / INTS_PER_PAGE;
+        proc->mapLength = (size_t)proc->pages * PAGE_SIZE;
+        proc->A = (int*)mmap(NULL, proc->mapLength, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (proc->A == MAP_FAILED) {
+            perror("Cannot map array A");
+            exit(EXIT_FAILURE);
+        }
+        proc->inMemory = (bool*)safeAlloc(proc->pages * sizeof(bool));
+        proc->populated = (bool*)safeAlloc(proc->pages * sizeof(bool));
+        proc->referenced = (bool*)safeAlloc(proc->pages * sizeof(bool));
+        proc->history = (uint16_t*)safeAlloc(proc->pages * sizeof(uint16_t));
+    }
+    NFF = USER_FRAMES - totalProcesses * ESSENTIAL_PAGES;
+}
+
+// Hand an evicted page back to the kernel
+void releasePage(Process *proc, int page) {
+    void *addr = (char*)proc->A + (size_t)page * PAGE_SIZE;
+    int rc = -1;
+    switch (advice) {
+#ifdef MADV_PAGEOUT
+        case ADV_PAGEOUT: rc = madvise(addr, PAGE_SIZE, MADV_PAGEOUT); break;
+#endif
+#ifdef MADV_COLD
+        case ADV_COLD: rc = madvise(addr, PAGE_SIZE, MADV_COLD); break;
+#endif
+        default: break;
+    }
+    if (rc != 0) {
+        // Not supported here: drop the page, its contents must be rewritten
+        madvise(addr, PAGE_SIZE, MADV_DONTNEED);
+        proc->populated[page] = false;
+    }
+}
+
+// Same victim choice as findVictimPage() in LRU.c
+int findVictimPage(Process *proc) {
+    int victim = -1;
+    uint16_t lowestUsage = 0xFFFF;
+    for (int page = 0; page < proc->pages; page++) {
+        if (proc->inMemory[page] && proc->history[page] < lowestUsage) {
+            lowestUsage = proc->history[page];
+            victim = page;
+        }
+    }
+    return victim;
+}
+
+// Touch A[M] for real; keep the simulator's view of frames alongside
+int accessElement(Process *proc, int M) {
+    int page = M / INTS_PER_PAGE;
+    char *addr = (char*)proc->A + (size_t)page * PAGE_SIZE;
+    unsigned char vec;
+
+    simAccesses++;
+    if (proc->populated[page] && checkEvery > 0 && ++writtenAccesses % checkEvery == 0) {
+        struct timespec c0, c1;
+        clock_gettime(CLOCK_MONOTONIC, &c0);
+        if (mincore(addr, PAGE_SIZE, &vec) == 0 && !(vec & 1)) {
+            notResident++;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &c1);
+        residencyChecks++;
+        checkSeconds += (c1.tv_sec - c0.tv_sec) + (c1.tv_nsec - c0.tv_nsec) / 1e9;
+    }
+
+    if (!proc->inMemory[page]) {
+        simFaults++;
+        if (NFF > NFFMIN) {
+            NFF--;
+        } else {
+            int victim = findVictimPage(proc);
+            if (victim < 0) {
+                fprintf(stderr, "Error: No suitable victim page found\n");
+                exit(EXIT_FAILURE);
+            }
+            simReplacements++;
+            proc->inMemory[victim] = false;
+            releasePage(proc, victim);
+            proc->resident--;
+        }
+        proc->inMemory[page] = true;
+        proc->history[page] = 0xFFFF;
+        proc->resident++;
+    }
+    proc->referenced[page] = true;
+
+    // Load the page: A[i] = i
+    if (!proc->populated[page]) {
+        int *p = proc->A + (size_t)page * INTS_PER_PAGE;
+        int first = page * INTS_PER_PAGE;
+        for (int i = 0; i < INTS_PER_PAGE; i++) p[i] = first + i;
+        proc->populated[page] = true;
+    }
+    return proc->A[M];
+}
+
+void binarySearch(Process *proc, int k) {
+    int L = 0;
+    int R = proc->s - 1;
+    while (L < R) {
+        int M = (L + R) / 2;
+        if (k <= accessElement(proc, M)) {
+            R = M;
+        } else {
+            L = M + 1;
+        }
+    }
+    sink = L;
+
+    // Age the reference history as in updatePageHistory()
+    for (int page = 0; page < proc->pages; page++) {
+        if (!proc->inMemory[page]) continue;
+        proc->history[page] = (proc->history[page] >> 1) | (proc->referenced[page] ? 0x8000 : 0);
+        proc->referenced[page] = false;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    char *end;
+    while ((opt = getopt(argc, argv, "a:c:")) != -1) {
+        if (opt == 'c' && (checkEvery = (int)strtol(optarg, &end, 10)) >= 0 && end != optarg && !*end) continue;
+        else if (opt == 'a' && strcmp(optarg, "pageout") == 0) advice = ADV_PAGEOUT;
+        else if (opt == 'a' && strcmp(optarg, "cold") == 0) advice = ADV_COLD;
+        else if (opt == 'a' && strcmp(optarg, "dontneed") == 0) advice = ADV_DONTNEED;
+        else {
+            fprintf(stderr, "Usage: %s [-a pageout|cold|dontneed] [-c check interval]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    readinput();
+
+    struct rusage before, after;
+    struct timespec t0, t1;
+    getrusage(RUSAGE_SELF, &before);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    // Round-robin execution, one search per turn, as in LRU.c
+    int finishedProcesses = 0;
+    while (finishedProcesses < totalProcesses) {
+        for (int i = 0; i < totalProcesses; i++) {
+            Process *proc = &processes[i];
+            if (proc->currentSearch >= proc->m) continue;
+
+            int key;
+            if (!parseInt(&proc->keyPos, &key)) {
+                fprintf(stderr, "Error reading search key %d for process %d\n", proc->currentSearch, i);
+                return EXIT_FAILURE;
+            }
+            binarySearch(proc, key);
+
+            if (++proc->currentSearch >= proc->m) {
+                finishedProcesses++;
+                NFF += proc->resident + ESSENTIAL_PAGES;
+                munmap(proc->A, proc->mapLength);
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    getrusage(RUSAGE_SELF, &after);
+
+    printf("+++ Real-memory replay of search.txt (evicted pages: %s)\n", adviceNames[advice]);
+    printf("    Page accesses                  = %ld\n", simAccesses);
+    printf("    Simulated page faults          = %ld (%.2f%%)\n", simFaults,
+           simAccesses ? simFaults * 100.0 / simAccesses : 0.0);
+    printf("    Simulated page replacements    = %ld\n", simReplacements);
+    printf("    Kernel minor faults            = %ld\n", after.ru_minflt - before.ru_minflt);
+    printf("    Kernel major faults            = %ld\n", after.ru_majflt - before.ru_majflt);
+    if (checkEvery > 0)
+        printf("    Swapped-out pages touched      = %ld of %ld checked (1 in %d accesses to written pages)\n",
+               notResident, residencyChecks, checkEvery);
+    else
+        printf("    Swapped-out pages touched      = not checked\n");
+    printf("    Elapsed time                   = %.3f s (replay), %.3f s (residency checks)\n",
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9 - checkSeconds, checkSeconds);
+
+    for (int i = 0; i < totalProcesses; i++) {
+        free(processes[i].inMemory);
+        free(processes[i].populated);
+        free(processes[i].referenced);
+        free(processes[i].history);
+    }
+    free(processes);
+    munmap((void*)inputData, inputSize);
+    return 0;
+}
@@ -2,17 +2,21 @@
 #include <stdlib.h>
 #include <time.h>
 
-void genschedule ( int n )
+void genschedule ( int n, const char *fname )
 {
    int i, j, b, IOmin = 50, CPUmin, CPUmax, IOmod = 151, CPUmod;
-   int A = 0;
+   long A = 0;   /* arrival times pass INT_MAX at a few million jobs */
    FILE *fp;
 
-   fp = (FILE *)fopen("proc.txt", "w");
+   fp = (FILE *)fopen(fname, "w");
+   if (fp == NULL) {
+      perror(fname);
+      exit(1);
+   }
    fprintf(fp, "%d\n", n);
 
    for (i=1; i<=n; ++i) {
-      fprintf(fp, "%5d %8d", i, A);
+      fprintf(fp, "%5d %8ld", i, A);
       if (rand() % 10) {    /* IO-bound job */
          b = 4 + rand() % 7;
          CPUmin = 1; CPUmax = 15;
@@ -36,6 +40,6 @@ int main ( int argc, char *argv[] )
 
    srand((unsigned int)time(NULL));
    n = (argc == 1) ? 100 : atoi(argv[1]);
-   genschedule(n);
+   genschedule(n, (argc > 2) ? argv[2] : "proc.txt");
    exit(0);
 }
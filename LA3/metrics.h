@@ -0,0 +1,131 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+// Run metrics in fixed memory, however many tasks a run has.
+// Hist: a log-linear (HDR-style) histogram of simulated times. Values below
+// 2^HIST_SUB_BITS get a bucket each; above that, every power of two is split
+// into 2^(HIST_SUB_BITS-1) equal buckets, so a quantile is off by at most
+// 1/2^HIST_SUB_BITS of its value.
+// WindowSeries: time-weighted averages of the ready-queue length and of the
+// busy cores over fixed windows of simulated time. A window is written out
+// as soon as it closes.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define HIST_SUB_BITS 5
+#define HIST_MAX_BIT 47 // larger values share the last bucket
+#define HIST_HALF (1 << (HIST_SUB_BITS - 1))
+#define HIST_BUCKETS ((HIST_MAX_BIT - HIST_SUB_BITS + 3) * HIST_HALF)
+
+typedef struct {
+    uint32_t counts[HIST_BUCKETS];
+    uint64_t count, max;
+    double sum;
+} Hist;
+
+static inline int hist_index(uint64_t v) {
+    if (v >= (uint64_t)1 << (HIST_MAX_BIT + 1)) v = ((uint64_t)1 << (HIST_MAX_BIT + 1)) - 1;
+    if (v < 2 * HIST_HALF) return (int)v;
+    int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS + 1;
+    return shift * HIST_HALF + (int)(v >> shift);
+}
+
+// Midpoint of bucket i
+static inline double hist_value(int i) {
+    if (i < 2 * HIST_HALF) return i;
+    int shift = i / HIST_HALF - 1;
+    uint64_t low = (uint64_t)(i - shift * HIST_HALF) << shift;
+    return low + (double)((uint64_t)1 << shift) / 2;
+}
+
+// Negative values count as 0
+static inline void hist_record(Hist* h, long long v) {
+    uint64_t u = v > 0 ? (uint64_t)v : 0;
+    h->counts[hist_index(u)]++;
+    h->count++;
+    h->sum += u;
+    if (u > h->max) h->max = u;
+}
+
+static inline double hist_mean(const Hist* h) {
+    return h->count ? h->sum / h->count : 0;
+}
+
+// q-quantile, at most the largest value recorded
+static inline double hist_quantile(const Hist* h, double q) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * h->count), seen = 0;
+    if (rank >= h->count) rank = h->count - 1;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > rank) {
+            double v = hist_value(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+typedef struct {
+    FILE* out;          // NULL: not recorded
+    int json;           // JSON objects, else CSV lines
+    const char* label;  // CSV: leading columns identifying the run
+    long long width;
+    int cores;
+    long long start;    // Current window
+    double ready_area, busy_area;
+    int ready_max;
+    long rows;
+} WindowSeries;
+
+static inline void window_init(WindowSeries* w, FILE* out, int json, const char* label, long long width, int cores) {
+    w->out = out;
+    w->json = json;
+    w->label = label;
+    w->width = width;
+    w->cores = cores;
+    w->start = 0;
+    w->ready_area = w->busy_area = 0;
+    w->ready_max = 0;
+    w->rows = 0;
+}
+
+// Write the current window, which covered len time units, and open the next
+static inline void window_emit(WindowSeries* w, long long len) {
+    double ready = len ? w->ready_area / len : 0;
+    double util = len ? 100.0 * w->busy_area / ((double)len * w->cores) : 0;
+    if (w->json)
+        fprintf(w->out, "%s\n      { \"start\": %lld, \"ready_avg\": %.3f, \"ready_max\": %d, \"utilization\": %.2f }",
+                w->rows ? "," : "", w->start, ready, w->ready_max, util);
+    else
+        fprintf(w->out, "%s,%lld,%.3f,%d,%.2f\n", w->label, w->start, ready, w->ready_max, util);
+    w->rows++;
+    w->start += len;
+    w->ready_area = w->busy_area = 0;
+}
+
+// ready tasks were queued and busy cores running from time `from` to `to`
+static inline void window_advance(WindowSeries* w, long long from, long long to, int ready, int busy) {
+    if (!w->out) return;
+    if (ready > w->ready_max) w->ready_max = ready;
+    while (from < to) {
+        long long end = w->start + w->width;
+        long long upto = to < end ? to : end;
+        w->ready_area += (double)ready * (upto - from);
+        w->busy_area += (double)busy * (upto - from);
+        from = upto;
+        if (from == end) {
+            window_emit(w, w->width);
+            w->ready_max = ready;
+        }
+    }
+}
+
+// Write the last, partial window of a run that ended at time end
+static inline void window_finish(WindowSeries* w, long long end) {
+    if (w->out && end > w->start)
+        window_emit(w, end - w->start);
+}
+
+#endif
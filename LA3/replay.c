@@ -0,0 +1,395 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+// Replays a proc file on real threads, to compare the simulator's
+// predictions with what the kernel delivers. A CPU burst is a busy loop
+// that consumes that much thread CPU time, an IO burst is a sleep; one time
+// unit is -u microseconds. Processes arrive at their start times and run on
+// -c CPUs, scheduled by the kernel (SCHED_OTHER or SCHED_RR, a thread per
+// process) or by a user-level round-robin scheduler (a worker thread per
+// CPU). Turnaround and wait times are reported in time units, in the
+// simulator's format.
+
+#define CPU_LIMIT 64
+
+// Scheduling under test
+typedef enum {
+    EXEC_OTHER,  // Kernel, SCHED_OTHER
+    EXEC_RR,     // Kernel, SCHED_RR
+    EXEC_USER    // User-level round robin with quantum `quantum`
+} ExecMode;
+
+typedef struct {
+    int task_id;
+    long long start_time;
+    int burst_count;
+    int* bursts;         // CPU/IO burst pairs (-1 after the last CPU burst)
+    long long activity_time;
+    // User-level scheduler
+    int burst_index;
+    long long cpu_left;  // ns of CPU time left in the current burst
+    long long done_ns;
+} Proc;
+
+const char* input_file = "proc.txt";
+Proc* procs;
+int proc_count;
+long long unit_ns = 1000000;  // One time unit
+int cpu_count = 1;
+ExecMode mode = EXEC_OTHER;
+int quantum = 10;
+long long epoch;  // Time 0 of the replay
+pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
+long long wait_total;
+long long last_done;
+
+long long clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+long long now_ns() {
+    return clock_ns(CLOCK_MONOTONIC) - epoch;
+}
+
+// Consume ns of this thread's CPU time; time spent preempted does not count
+void spin(long long ns) {
+    long long end = clock_ns(CLOCK_THREAD_CPUTIME_ID) + ns;
+    while (clock_ns(CLOCK_THREAD_CPUTIME_ID) < end)
+        ;
+}
+
+void sleep_until(long long t) {
+    t += epoch;
+    struct timespec ts = { t / 1000000000, t % 1000000000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+// Run the calling thread on CPUs first .. first+count-1
+void pin(int first, int count) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c = first; c < first + count; c++)
+        CPU_SET(c, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err) {
+        printf("Error: Cannot run on CPUs %d-%d: %s\n", first, first + count - 1, strerror(err));
+        exit(1);
+    }
+}
+
+// Next integer of the input
+long long read_number(FILE* input) {
+    long long v;
+    if (fscanf(input, "%lld", &v) != 1) {
+        printf("Error: Malformed %s\n", input_file);
+        exit(1);
+    }
+    return v;
+}
+
+void read_procs() {
+    FILE* input = fopen(input_file, "r");
+    if (!input) {
+        printf("Failed to open %s\n", input_file);
+        exit(1);
+    }
+    proc_count = (int)read_number(input);
+    procs = calloc(proc_count > 0 ? proc_count : 1, sizeof(Proc));
+    for (int i = 0; i < proc_count; i++) {
+        Proc* p = &procs[i];
+        p->task_id = (int)read_number(input);
+        p->start_time = read_number(input);
+        int capacity = 16;
+        p->bursts = malloc(capacity * sizeof(int));
+        while (1) {
+            if (2 * p->burst_count + 2 > capacity) {
+                capacity *= 2;
+                p->bursts = realloc(p->bursts, capacity * sizeof(int));
+            }
+            int cpu = p->bursts[2 * p->burst_count] = (int)read_number(input);
+            int io = p->bursts[2 * p->burst_count + 1] = (int)read_number(input);
+            p->burst_count++;
+            p->activity_time += cpu;
+            if (io == -1) break;
+            p->activity_time += io;
+        }
+        if (i > 0 && p->start_time < procs[i - 1].start_time) {
+            printf("Error: Process %d in %s arrives before the one above it\n", p->task_id, input_file);
+            exit(1);
+        }
+    }
+    fclose(input);
+}
+
+// A process finished at time done_ns
+void proc_done(Proc* p, long long done_ns) {
+    long long turnaround = (done_ns - p->start_time * unit_ns + unit_ns / 2) / unit_ns;
+    pthread_mutex_lock(&print_mutex);
+    p->done_ns = done_ns;
+    wait_total += turnaround - p->activity_time;
+    if (done_ns > last_done)
+        last_done = done_ns;
+    printf("%lld : Process %d exits. Turnaround time = %lld (%lld%%), Wait time = %lld\n",
+           (done_ns + unit_ns / 2) / unit_ns, p->task_id, turnaround,
+           turnaround * 100 / p->activity_time, turnaround - p->activity_time);
+    pthread_mutex_unlock(&print_mutex);
+}
+
+// Kernel scheduling: a thread per process, created when it arrives
+void* proc_thread(void* arg) {
+    Proc* p = arg;
+    pin(0, cpu_count);
+    for (int k = 0; k < p->burst_count; k++) {
+        spin(p->bursts[2 * k] * unit_ns);
+        if (p->bursts[2 * k + 1] != -1)
+            sleep_until(now_ns() + p->bursts[2 * k + 1] * unit_ns);
+    }
+    proc_done(p, now_ns());
+    return NULL;
+}
+
+void run_kernel() {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (mode == EXEC_RR) {
+        // The launcher outranks the processes, or busy SCHED_RR threads
+        // would keep it from starting the next arrival
+        struct sched_param param = { sched_get_priority_min(SCHED_RR) };
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_RR);
+        pthread_attr_setschedparam(&attr, &param);
+        struct sched_param launcher = { param.sched_priority + 1 };
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &launcher);
+        if (err) {
+            printf("Error: SCHED_RR needs root or CAP_SYS_NICE: %s\n", strerror(err));
+            exit(1);
+        }
+    }
+
+    pthread_t* threads = malloc((proc_count > 0 ? proc_count : 1) * sizeof(pthread_t));
+    for (int i = 0; i < proc_count; i++) {
+        sleep_until(procs[i].start_time * unit_ns);
+        int err = pthread_create(&threads[i], &attr, proc_thread, &procs[i]);
+        if (err) {
+            printf("Error: Cannot start process %d: %s\n", procs[i].task_id, strerror(err));
+            exit(1);
+        }
+    }
+    for (int i = 0; i < proc_count; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_attr_destroy(&attr);
+}
+
+// User-level scheduler: worker threads take processes from one FIFO ready
+// queue and run them for a quantum of CPU time each. The main thread is
+// the timer: it moves processes to the ready queue when they arrive or
+// their IO completes.
+pthread_mutex_t sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ready_cond;  // Ready queue not empty, or all done
+pthread_cond_t timer_cond;  // New timer, or all done
+int* ready_queue;           // Ring of proc indices
+int ready_head, ready_size;
+int done_count;
+
+typedef struct {
+    long long when;
+    int proc;
+} Timer;
+
+Timer* timers;              // Min-heap on when
+int timer_count;
+
+void ready_push(int i) {
+    ready_queue[(ready_head + ready_size++) % proc_count] = i;
+    pthread_cond_signal(&ready_cond);
+}
+
+void timer_push(long long when, int i) {
+    int pos = timer_count++;
+    while (pos > 0 && timers[(pos - 1) / 2].when > when) {
+        timers[pos] = timers[(pos - 1) / 2];
+        pos = (pos - 1) / 2;
+    }
+    timers[pos].when = when;
+    timers[pos].proc = i;
+}
+
+Timer timer_pop() {
+    Timer top = timers[0], last = timers[--timer_count];
+    int pos = 0;
+    while (2 * pos + 1 < timer_count) {
+        int child = 2 * pos + 1;
+        if (child + 1 < timer_count && timers[child + 1].when < timers[child].when)
+            child++;
+        if (timers[child].when >= last.when)
+            break;
+        timers[pos] = timers[child];
+        pos = child;
+    }
+    timers[pos] = last;
+    return top;
+}
+
+void* worker_thread(void* arg) {
+    pin((int)(long)arg, 1);
+    long long slice_max = quantum > 0 ? quantum * unit_ns : -1;
+    pthread_mutex_lock(&sched_mutex);
+    while (1) {
+        while (ready_size == 0 && done_count < proc_count)
+            pthread_cond_wait(&ready_cond, &sched_mutex);
+        if (done_count == proc_count)
+            break;
+        int i = ready_queue[ready_head];
+        ready_head = (ready_head + 1) % proc_count;
+        ready_size--;
+        pthread_mutex_unlock(&sched_mutex);
+
+        Proc* p = &procs[i];
+        long long slice = slice_max < 0 || p->cpu_left < slice_max ? p->cpu_left : slice_max;
+        spin(slice);
+        p->cpu_left -= slice;
+        long long now = now_ns();
+        int io = p->bursts[2 * p->burst_index + 1];
+        if (p->cpu_left == 0 && io == -1)
+            proc_done(p, now);
+
+        pthread_mutex_lock(&sched_mutex);
+        if (p->cpu_left > 0) {
+            ready_push(i);  // Quantum expired
+        } else if (io == -1) {
+            if (++done_count == proc_count) {
+                pthread_cond_broadcast(&ready_cond);
+                pthread_cond_signal(&timer_cond);
+            }
+        } else {
+            p->burst_index++;
+            p->cpu_left = p->bursts[2 * p->burst_index] * unit_ns;
+            timer_push(now + io * unit_ns, i);
+            pthread_cond_signal(&timer_cond);
+        }
+    }
+    pthread_mutex_unlock(&sched_mutex);
+    return NULL;
+}
+
+void run_user() {
+    pthread_condattr_t monotonic;
+    pthread_condattr_init(&monotonic);
+    pthread_condattr_setclock(&monotonic, CLOCK_MONOTONIC);
+    pthread_cond_init(&ready_cond, NULL);
+    pthread_cond_init(&timer_cond, &monotonic);
+    ready_queue = malloc((proc_count > 0 ? proc_count : 1) * sizeof(int));
+    timers = malloc((proc_count > 0 ? proc_count : 1) * sizeof(Timer));
+    for (int i = 0; i < proc_count; i++) {
+        procs[i].cpu_left = procs[i].bursts[0] * unit_ns;
+        timer_push(procs[i].start_time * unit_ns, i);
+    }
+
+    pthread_t workers[CPU_LIMIT];
+    for (int c = 0; c < cpu_count; c++)
+        pthread_create(&workers[c], NULL, worker_thread, (void*)(long)c);
+
+    pthread_mutex_lock(&sched_mutex);
+    while (done_count < proc_count) {
+        if (timer_count > 0 && timers[0].when <= now_ns()) {
+            ready_push(timer_pop().proc);
+            continue;
+        }
+        if (timer_count == 0) {
+            pthread_cond_wait(&timer_cond, &sched_mutex);
+        } else {
+            long long t = timers[0].when + epoch;
+            struct timespec ts = { t / 1000000000, t % 1000000000 };
+            pthread_cond_timedwait(&timer_cond, &sched_mutex, &ts);
+        }
+    }
+    pthread_mutex_unlock(&sched_mutex);
+    for (int c = 0; c < cpu_count; c++)
+        pthread_join(workers[c], NULL);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "f:u:c:p:")) != -1) {
+        switch (opt) {
+            case 'f':
+                input_file = optarg;
+                break;
+            case 'u':
+                unit_ns = atoll(optarg) * 1000;
+                if (unit_ns <= 0) {
+                    printf("Error: The time unit must be positive\n");
+                    exit(1);
+                }
+                break;
+            case 'c':
+                cpu_count = atoi(optarg);
+                if (cpu_count < 1 || cpu_count > CPU_LIMIT) {
+                    printf("Error: Number of CPUs must be between 1 and %d\n", CPU_LIMIT);
+                    exit(1);
+                }
+                break;
+            case 'p':
+                if (strcmp(optarg, "other") == 0) {
+                    mode = EXEC_OTHER;
+                } else if (strcmp(optarg, "rr") == 0) {
+                    mode = EXEC_RR;
+                } else if (strncmp(optarg, "user", 4) == 0 && (optarg[4] == '\0' || optarg[4] == ':')) {
+                    mode = EXEC_USER;
+                    if (optarg[4] == ':')
+                        quantum = atoi(optarg + 5);  // 0: run each burst to completion
+                } else {
+                    printf("Error: Unknown scheduler %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            default:
+                printf("Usage: %s [-f proc_file] [-u usec_per_unit] [-c cpus] [-p other|rr|user[:q]]\n", argv[0]);
+                exit(1);
+        }
+    }
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count > online) {
+        printf("Error: Only %ld CPUs online\n", online);
+        exit(1);
+    }
+    read_procs();
+    printf("**** Replay under ");
+    if (mode == EXEC_OTHER) {
+        printf("SCHED_OTHER ");
+    } else if (mode == EXEC_RR) {
+        int slice_ms = 0;
+        FILE* f = fopen("/proc/sys/kernel/sched_rr_timeslice_ms", "r");
+        if (f) {
+            if (fscanf(f, "%d", &slice_ms) != 1) slice_ms = 0;
+            fclose(f);
+        }
+        printf("SCHED_RR (kernel quantum %d ms) ", slice_ms);
+    } else {
+        printf("user-level RR with q = %d ", quantum);
+    }
+    printf("on %d CPU%s, 1 unit = %lld us ****\n", cpu_count, cpu_count > 1 ? "s" : "", unit_ns / 1000);
+
+    epoch = clock_ns(CLOCK_MONOTONIC);
+    if (mode == EXEC_USER)
+        run_user();
+    else
+        run_kernel();
+
+    printf("Average wait time = %.2f\n", proc_count ? (double)wait_total / proc_count : 0.0);
+    printf("Total turnaround time = %lld\n", (last_done + unit_ns / 2) / unit_ns);
+    printf("\n");
+    return 0;
+}
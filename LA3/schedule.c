@@ -1,11 +1,41 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "metrics.h"
 
-#define BURST_LIMIT 25
-#define PROC_LIMIT 1500
+#define CORE_LIMIT 64
+#define THREAD_LIMIT 256
+#define DEVICE_LIMIT 64
 #define TIME_INFINITY 1000000000
 
+// Children per node of the event heap
+#ifndef HEAP_ARITY
+#define HEAP_ARITY 4
+#endif
+
+// Policy tuning
+#define SJF_INITIAL 10        // Burst estimate before a task's first burst
+#define SJF_ALPHA 0.5         // Weight of the last burst in the estimate
+#define MLFQ_LEVELS 3         // Level k runs for quantum << k, the last one to completion
+#define MLFQ_BOOST 1000       // Every task returns to level 0 this often
+#define CFS_MIN_GRANULARITY 2 // Shortest CFS slice
+#define CFS_WAKEUP_GRANULARITY 4  // vruntime lead a waking task needs to preempt
+#define TICKETS 100           // Lottery tickets and stride weight of every task
+#define STRIDE1 10000         // Stride of a task with TICKETS tickets is STRIDE1 / TICKETS
+#define LOTTERY_SEED 12345
+
+// Streaming
+#define GEN_SEED 4242         // Generated workloads
+
+// Shared IO devices
+#define IO_TRACKS 1024        // Track positions; a seek costs its share of a full stroke
+
 // Process states
 typedef enum {
     PROC_INIT,
@@ -15,21 +45,69 @@ typedef enum {
     PROC_DONE
 } ProcStatus;
 
-// PCB
+// A process as read from the input; shared read-only by every run
 typedef struct {
     int task_id;
-    int start_time;
     int burst_count;
-    int compute_times[BURST_LIMIT];
-    int wait_times[BURST_LIMIT];
+    long long start_time;
+    long long activity_time;
+    long burst_base;     // Its CPU/IO burst pairs start at burst_arena[burst_base]
+    const int* bursts;   // &burst_arena[burst_base], set once the arena is complete
+} TaskInfo;
+
+// A proc file, loaded once; or a source of arrivals that each run reads as
+// simulated time reaches them (a streamed file, "-" for stdin, or generated)
+typedef struct {
+    const char* file;
+    int stream;        // Read during each run instead of up front
+    long generate;     // Generated workload: number of tasks (0 for a file)
+    TaskInfo* tasks;
+    int task_count;
+    int* burst_arena;  // Every task's CPU/IO burst pairs
+} Workload;
+
+// PCB: the state a run changes
+typedef struct {
+    const TaskInfo* info;
+    const int* bursts;  // info->bursts, copied for the hot path
     int burst_index;
     int time_left;
     ProcStatus status;
-    int completion_time;
-    int queue_time;
-    int activity_time;
+    int core;       // Core it runs on, or last ran on (-1 before its first run)
+    long long completion_time;
+    long long queue_time;
+    long long run_start;  // When its current run began (after any switching costs)
+    long long last_ran;   // When its last run ended, -1 before its first run
+    int gen;        // Bumped when it is preempted; its pending event is then stale
+    double prio;    // Ready queue key, lowest runs first
+    union {         // Policy state, set by the policy's init()
+        double estimate;   // SJF/SRTF: predicted length of the current CPU burst
+        int level;         // MLFQ: queue level
+        double vruntime;   // CFS: CPU time received
+        struct {
+            int tickets;   // Lottery, stride: current tickets (lottery: compensation included)
+            double pass;   // Stride: virtual finishing time of its next quantum
+        };
+        long long deadline;  // EDF: absolute deadline of the current CPU burst
+    };
+    // Shared IO devices
+    int io_next;         // Next request in its device's queue, -1 at the tail
+    int io_track;        // Track of its pending request
+    long long io_queued; // When the request joined the queue
 } Task;
 
+// Streaming: a pooled copy of an active task's process
+typedef struct {
+    TaskInfo info;
+    int* bursts;         // Owned; info.bursts points here
+    long burst_capacity;
+    int next_free;       // Free-list link
+} TaskSlot;
+
+// CPU burst k and the IO burst after it (-1 after the last CPU burst)
+#define CPU_BURST(t, k) ((t)->bursts[2 * (k)])
+#define IO_BURST(t, k) ((t)->bursts[2 * (k) + 1])
+
 // Events
 typedef enum {
     EVT_START,
@@ -38,328 +116,1689 @@ typedef enum {
     EVT_PREEMPT
 } EventCategory;
 
-// Event structure
+// Event structure. Events are ordered by time, then by one 32-bit order
+// built once when the event is pushed: rank (a PREEMPT comes after a START,
+// UNBLOCK or COMPLETE at the same time, so a task that times out queues
+// behind the tasks that become ready with it), then task_id.
 typedef struct {
-    int timestamp;
+    long long time;
+    uint32_t order;  // rank << 31 | task_id
     int task_index;  // Index into process-info table
     EventCategory category;
+    int gen;         // Task's gen when the event was pushed
 } SchedulerEvent;
 
-// Global state
-Task task_list[PROC_LIMIT];  // Process-info table
-int task_count;
-SchedulerEvent event_queue[PROC_LIMIT * BURST_LIMIT * 4];
-int queue_size = 0;
+// Ready queue --> binary min-heap on (prio, seq); equal priorities run FIFO
+typedef struct {
+    double prio;
+    long seq;        // Enqueue order
+    int task_index;  // Index into process-info table
+} ReadyEntry;
+
+typedef struct {
+    ReadyEntry* items;
+    int size;
+    long capacity;
+} ReadyQueue;
 
-// Ready queue --> circular array
-int ready_queue[PROC_LIMIT];  // Stores indices into process-info table
-int ready_front = 0;
-int ready_rear = 0;
+// Load balancing across cores
+typedef enum {
+    BAL_GLOBAL,  // One ready queue shared by all cores
+    BAL_STEAL    // A ready queue per core; an idle core steals from the longest one
+} BalanceMode;
 
-// System state
-int system_time = 0;
-int idle_periods = 0;
-int running_task = -1;  // Index into process-info table
+// CPU core
+typedef struct {
+    int running;         // Index into process-info table, -1 if idle
+    long long idle_time;
+    long long idle_since;      // When the core last went idle
+    int migrations;            // Tasks dispatched here that last ran on another core
+    long long migration_time;  // Time lost to those migrations
+    int last_task;             // Task it ran last, -1 if none
+    long switches;             // Dispatches of a task other than last_task
+    long long switch_time;     // Time lost to context switches
+    long long refill_time;     // Time lost refilling the cache
+    ReadyQueue rq;       // BAL_STEAL: this core's ready queue
+} Core;
+
+// Order in which a shared IO device serves its queue
+typedef enum {
+    IO_FIFO,
+    IO_ELEVATOR  // LOOK: nearest track ahead of the head, reversing when none is left
+} IoDiscipline;
+
+// Shared IO device: serves one request at a time, the rest queue
+typedef struct {
+    int busy;            // Task being served, -1 if idle
+    int head, tail;      // Queue of requests, linked through Task.io_next
+    int queued, queue_max;
+    int track;           // Head position
+    int up;              // Elevator: moving towards higher tracks
+    long requests;
+    long long busy_time;   // Seeking and transferring
+    long long seek_time;
+    long long wait_time;   // Requests' time in the queue
+} IoDevice;
+
+// Why a task enters the ready queue
+typedef enum {
+    READY_ARRIVAL,
+    READY_IO,         // IO completed
+    READY_TIMEOUT,    // Its time slice expired
+    READY_PREEMPTED   // A task with a better priority became ready
+} ReadyReason;
+
+// How a run on a core ended
+typedef enum {
+    RAN_BURST_DONE,
+    RAN_SLICE_EXPIRED,
+    RAN_PREEMPTED
+} RunOutcome;
+
+typedef struct Simulation Simulation;
+
+// Scheduling policy. init() sets up a task's policy state, ready() sets
+// t->prio when the task is queued, slice() bounds each run, ran() is told
+// how long a run lasted and how it ended.
+// A policy with running_prio() preempts a running task whose current
+// priority is worse than that of a task becoming ready.
+typedef struct {
+    const char* name;     // On the command line, optionally name:param
+    const char* title;    // In the run header
+    const char* param_label;  // In the run header, NULL if the policy has no parameter
+    int param_default;
+    void (*init)(Simulation* sim, Task* t);
+    void (*ready)(Simulation* sim, Task* t, ReadyReason why);
+    int (*slice)(Simulation* sim, Task* t);
+    void (*ran)(Simulation* sim, Task* t, int ran, RunOutcome how);
+    double (*running_prio)(Simulation* sim, Task* t);
+} Policy;
+
+// A run requested on the command line
+typedef struct {
+    const Policy* policy;
+    int param;
+} PolicyRun;
+
+// What a run reports
+typedef struct {
+    double avg_wait;
+    long long final_time;  // Total turnaround time
+    long long idle_time;   // Summed over all cores
+    double utilization;    // Percent of the cores' time spent running tasks
+    long switches;
+    long long overhead;    // Time lost to context switches, cache refills and migrations
+    double useful_utilization;  // utilization less the overhead
+    double wait_q[3], response_q[3], turnaround_q[3];  // p50, p95, p99 over the tasks
+    double io_wait;        // Mean time an IO request queues for its device
+    double io_utilization; // Mean over the devices
+} RunResult;
+
+// One run of a policy on a workload. Everything a run changes lives here,
+// so independent runs can execute on different threads; the storage is
+// kept from one run to the next.
+struct Simulation {
+    // Configuration
+    const Workload* work;
+    const Policy* policy;
+    int param;               // Quantum, CFS target latency or EDF deadline factor
+    int core_count;
+    BalanceMode balance;
+    int migration_cost;      // CPU time lost when a task runs on a different core than last time
+    int switch_cost;         // CPU time lost when a core switches to another task
+    int refill_max;          // CPU time lost refilling the cache of a task that ran long ago
+    double refill_tau;       // Time over which a task's cache goes cold
+    int quiet;               // No per-process lines
+    int io_devices;          // Shared IO devices, 0: every IO burst runs on its own device
+    IoDiscipline io_discipline;
+    int seek_max;            // Time to seek across all IO_TRACKS tracks
+
+    // System state
+    Task* tasks;             // Process-info table, parallel to work->tasks (streaming: to slots)
+    int task_count;          // Entries of tasks in use
+    long task_capacity;
+    SchedulerEvent* event_queue;
+    int queue_size;
+    long queue_capacity;
+    ReadyQueue global_rq;    // BAL_GLOBAL: the shared ready queue
+    long ready_seq;          // Enqueue counter
+    int ready_count;         // Tasks in all ready queues
+    long long system_time;
+    Core cores[CORE_LIMIT];
+    IoDevice devices[DEVICE_LIMIT];
+
+    // Policy state shared by the tasks
+    double virtual_time;     // Largest priority dispatched so far (CFS, lottery, stride)
+    long long next_boost;    // MLFQ
+    unsigned long long rng;  // Lottery
+    long deadline_misses, deadline_bursts;  // EDF
+
+    // Streaming: the next arrival is read when the previous one starts, and
+    // tasks live in slots that are reused once they exit
+    TaskSlot* slots;
+    long slot_capacity;
+    int free_slot;           // Head of the free list, -1 if none
+    FILE* input;             // NULL once the source is exhausted
+    long to_read;            // Arrivals left in the source, -1 for "until end of file"
+    unsigned long long gen_rng;   // Generator state
+    long long gen_arrival;
+    int active_tasks, peak_active;
+
+    long long wait_total;    // Over the tasks that exited
+    long done_count;
+    Hist wait_hist, response_hist, turnaround_hist;
+    WindowSeries windows;    // -m: ready-queue length and utilization over time
+    long long window_time;   // Windows are filled up to here
+    char label[256];
+    RunResult result;
+    long events_processed;
+    double loop_seconds;     // Wall time of the event loop
+};
+
+// Command line
+Workload* workloads;
+int workload_count = 0;
+long workload_capacity = 0;
+PolicyRun* runs;
+int run_count = 0;
+long run_capacity = 0;
+int core_count = 1;
+BalanceMode balance = BAL_GLOBAL;
+int migration_cost = 0;
+int switch_cost = 0;
+int refill_max = 0;
+double refill_tau = 100;
+int io_devices = 0;
+IoDiscipline io_discipline = IO_FIFO;
+int seek_max = 0;
+int quiet = 0;  // -q: no per-process lines
+int sweep = 0;  // -S: run everything in parallel and print a CSV
+int stream = 0; // -s: stream the proc files
+FILE* metrics_out;  // -m: per-run metrics, JSON if the file name ends in .json, else CSV
+int metrics_json = 0;
+int metrics_runs = 0;
+long long window_width = 1000;  // -w
+
+// Double an array of *capacity elements of the given size
+void* grow_array(void* items, long* capacity, size_t size) {
+    *capacity = *capacity ? 2 * *capacity : 1024;
+    items = realloc(items, *capacity * size);
+    if (!items) {
+        printf("Error: Out of memory\n");
+        exit(1);
+    }
+    return items;
+}
+
+double seconds_between(struct timespec* start, struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
 
 // Ready queue ops
-int is_ready_queue_empty() {
-    return ready_front == ready_rear;
+int is_ready_queue_empty(ReadyQueue* q) {
+    return q->size == 0;
 }
 
-int is_ready_queue_full() {
-    return (ready_rear + 1) % PROC_LIMIT == ready_front;
+int ready_queue_length(ReadyQueue* q) {
+    return q->size;
 }
 
-void ready_queue_enqueue(int task_index) {
-    if (is_ready_queue_full()) {
-        printf("Error: Ready queue overflow\n");
-        exit(1);
+int ready_entry_less(ReadyEntry* a, ReadyEntry* b) {
+    return a->prio < b->prio || (a->prio == b->prio && a->seq < b->seq);
+}
+
+void ready_queue_sift_up(ReadyQueue* q, int pos) {
+    ReadyEntry e = q->items[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!ready_entry_less(&e, &q->items[parent]))
+            break;
+        q->items[pos] = q->items[parent];
+        pos = parent;
     }
-    ready_queue[ready_rear] = task_index;
-    ready_rear = (ready_rear + 1) % PROC_LIMIT;
-    task_list[task_index].status = PROC_QUEUED;
+    q->items[pos] = e;
 }
 
-int ready_queue_dequeue() {
-    if (is_ready_queue_empty()) {
-        return -1;
+void ready_queue_sift_down(ReadyQueue* q, int pos) {
+    ReadyEntry e = q->items[pos];
+    while (1) {
+        int child = 2 * pos + 1;
+        if (child >= q->size)
+            break;
+        if (child + 1 < q->size && ready_entry_less(&q->items[child + 1], &q->items[child]))
+            child++;
+        if (!ready_entry_less(&q->items[child], &e))
+            break;
+        q->items[pos] = q->items[child];
+        pos = child;
+    }
+    q->items[pos] = e;
+}
+
+void ready_queue_enqueue(Simulation* sim, ReadyQueue* q, int task_index) {
+    if (q->size == q->capacity)
+        q->items = grow_array(q->items, &q->capacity, sizeof(ReadyEntry));
+    ReadyEntry e = { sim->tasks[task_index].prio, sim->ready_seq++, task_index };
+    q->items[q->size++] = e;
+    ready_queue_sift_up(q, q->size - 1);
+    sim->tasks[task_index].status = PROC_QUEUED;
+    sim->ready_count++;
+}
+
+// Remove the entry at pos
+int ready_queue_remove(Simulation* sim, ReadyQueue* q, int pos) {
+    int task_index = q->items[pos].task_index;
+    q->items[pos] = q->items[--q->size];
+    if (pos < q->size) {
+        ready_queue_sift_up(q, pos);
+        ready_queue_sift_down(q, pos);
     }
-    int task_index = ready_queue[ready_front];
-    ready_front = (ready_front + 1) % PROC_LIMIT;
+    sim->ready_count--;
     return task_index;
 }
 
-// Event queue ops
-void swap_events(SchedulerEvent* a, SchedulerEvent* b) {
-    SchedulerEvent temp = *a;
-    *a = *b;
-    *b = temp;
+int ready_queue_dequeue(Simulation* sim, ReadyQueue* q) {
+    if (is_ready_queue_empty(q)) {
+        return -1;
+    }
+    if (q->items[0].prio > sim->virtual_time)
+        sim->virtual_time = q->items[0].prio;
+    return ready_queue_remove(sim, q, 0);
 }
 
-int compare_events(SchedulerEvent* a, SchedulerEvent* b) {
-    if (a->timestamp != b->timestamp) 
-        return a->timestamp - b->timestamp;
-    
-    if (a->category != b->category) {
-        if ((a->category == EVT_START || a->category == EVT_UNBLOCK) && 
-            b->category == EVT_PREEMPT)
-            return -1;
-        if ((b->category == EVT_START || b->category == EVT_UNBLOCK) && 
-            a->category == EVT_PREEMPT)
-            return 1;
+// Take the task that would run last (the end a thief steals from); it is a leaf
+int ready_queue_dequeue_last(Simulation* sim, ReadyQueue* q) {
+    if (is_ready_queue_empty(q)) {
+        return -1;
     }
-    
-    return task_list[a->task_index].task_id - task_list[b->task_index].task_id;
+    int worst = q->size / 2;
+    for (int i = worst + 1; i < q->size; i++) {
+        if (ready_entry_less(&q->items[worst], &q->items[i]))
+            worst = i;
+    }
+    return ready_queue_remove(sim, q, worst);
 }
 
-void event_queue_push(SchedulerEvent evt) {
-    if (queue_size >= PROC_LIMIT * BURST_LIMIT * 4) {
-        printf("Error: Event queue overflow\n");
-        exit(1);
+// Reload every key from tasks[].prio after the policy changed them
+void ready_queue_rekey(Simulation* sim, ReadyQueue* q) {
+    for (int i = 0; i < q->size; i++)
+        q->items[i].prio = sim->tasks[q->items[i].task_index].prio;
+    for (int i = q->size / 2 - 1; i >= 0; i--)
+        ready_queue_sift_down(q, i);
+}
+
+// Ready queue a core dispatches from
+ReadyQueue* core_queue(Simulation* sim, int core) {
+    return sim->balance == BAL_GLOBAL ? &sim->global_rq : &sim->cores[core].rq;
+}
+
+// Core whose queue receives a task that becomes ready: its last core, else
+// the core with the least work (queued plus running), lowest index on ties
+int pick_core(Simulation* sim, int task_index) {
+    if (sim->tasks[task_index].core >= 0)
+        return sim->tasks[task_index].core;
+    int best = 0, best_load = INT_MAX;
+    for (int c = 0; c < sim->core_count; c++) {
+        int load = ready_queue_length(&sim->cores[c].rq) + (sim->cores[c].running != -1);
+        if (load < best_load) {
+            best = c;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+// Idle core with an empty queue: take a task from the longest queue of a
+// busy core (an idle core is about to run the head of its own queue)
+int steal_task(Simulation* sim, int core) {
+    int victim = -1, longest = 0;
+    for (int c = 0; c < sim->core_count; c++) {
+        int len = ready_queue_length(&sim->cores[c].rq);
+        if (c != core && sim->cores[c].running != -1 && len > longest) {
+            victim = c;
+            longest = len;
+        }
+    }
+    return victim == -1 ? -1 : ready_queue_dequeue_last(sim, &sim->cores[victim].rq);
+}
+
+// CPU time still needed by the current burst, counting a run in progress
+int time_left_now(Simulation* sim, Task* t) {
+    if (t->status != PROC_ACTIVE || sim->system_time <= t->run_start)
+        return t->time_left;
+    return t->time_left - (int)(sim->system_time - t->run_start);
+}
+
+// FCFS and RR: FIFO, all priorities equal; no state
+void fifo_ready(Simulation* sim, Task* t, ReadyReason why) {
+    t->prio = 0;
+}
+
+int fcfs_slice(Simulation* sim, Task* t) {
+    return TIME_INFINITY;
+}
+
+int rr_slice(Simulation* sim, Task* t) {
+    return sim->param;
+}
+
+// SJF and SRTF: shortest predicted burst first; the prediction is the
+// exponential average of the task's past bursts
+void sjf_init(Simulation* sim, Task* t) {
+    t->estimate = SJF_INITIAL;
+}
+
+void sjf_ready(Simulation* sim, Task* t, ReadyReason why) {
+    t->prio = t->estimate;
+}
+
+void sjf_ran(Simulation* sim, Task* t, int ran, RunOutcome how) {
+    if (how == RAN_BURST_DONE)
+        t->estimate = SJF_ALPHA * CPU_BURST(t, t->burst_index) + (1 - SJF_ALPHA) * t->estimate;
+}
+
+// Predicted remaining time of the current burst
+double srtf_prio(Simulation* sim, Task* t) {
+    double left = t->estimate - (CPU_BURST(t, t->burst_index) - time_left_now(sim, t));
+    return left > 0 ? left : 0;
+}
+
+void srtf_ready(Simulation* sim, Task* t, ReadyReason why) {
+    t->prio = srtf_prio(sim, t);
+}
+
+// MLFQ: a task that uses up its slice drops a level; a task that gives up
+// the CPU earlier keeps its level; all tasks go back to level 0 periodically
+void mlfq_init(Simulation* sim, Task* t) {
+    t->level = 0;
+}
+
+void mlfq_ready(Simulation* sim, Task* t, ReadyReason why) {
+    if (sim->system_time >= sim->next_boost) {
+        sim->next_boost = sim->system_time + MLFQ_BOOST;
+        for (int i = 0; i < sim->task_count; i++)
+            sim->tasks[i].level = sim->tasks[i].prio = 0;
+        for (int c = 0; c < (sim->balance == BAL_GLOBAL ? 1 : sim->core_count); c++)
+            ready_queue_rekey(sim, core_queue(sim, c));
     }
+    t->prio = t->level;
+}
+
+int mlfq_slice(Simulation* sim, Task* t) {
+    return t->level == MLFQ_LEVELS - 1 ? TIME_INFINITY : sim->param << t->level;
+}
+
+void mlfq_ran(Simulation* sim, Task* t, int ran, RunOutcome how) {
+    if (how == RAN_SLICE_EXPIRED && t->level < MLFQ_LEVELS - 1)
+        t->level++;
+}
+
+double mlfq_running_prio(Simulation* sim, Task* t) {
+    return t->level;
+}
+
+// CFS: least virtual runtime first; the slice shares the target latency
+// among the ready tasks. A waking task is placed at most half a target
+// latency behind the tasks already running, so sleeping earns little credit.
+void cfs_init(Simulation* sim, Task* t) {
+    t->vruntime = 0;
+}
+
+void cfs_ready(Simulation* sim, Task* t, ReadyReason why) {
+    if (why == READY_ARRIVAL || why == READY_IO) {
+        double floor = sim->virtual_time - sim->param / 2.0;
+        if (t->vruntime < floor)
+            t->vruntime = floor;
+    }
+    t->prio = t->vruntime;
+}
+
+int cfs_slice(Simulation* sim, Task* t) {
+    int slice = sim->param / (sim->ready_count + 1);
+    return slice > CFS_MIN_GRANULARITY ? slice : CFS_MIN_GRANULARITY;
+}
+
+void cfs_ran(Simulation* sim, Task* t, int ran, RunOutcome how) {
+    t->vruntime += ran;
+}
+
+double cfs_running_prio(Simulation* sim, Task* t) {
+    return t->vruntime + (t->time_left - time_left_now(sim, t)) - CFS_WAKEUP_GRANULARITY;
+}
+
+// Lottery: every dispatch is a draw weighted by tickets. Each queued task
+// holds an exponential clock with rate equal to its tickets, and the first
+// to ring wins, which picks a task with probability proportional to its
+// tickets and keeps the queue a heap. A task that gave up the CPU after a
+// fraction f of its quantum holds 1/f times the tickets (compensation).
+unsigned long long xorshift(unsigned long long* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+double random_exponential(Simulation* sim, double rate) {
+    double u = ((xorshift(&sim->rng) >> 11) + 0.5) / 9007199254740992.0;
+    return -log(u) / rate;
+}
+
+void lottery_init(Simulation* sim, Task* t) {
+    t->tickets = TICKETS;
+    t->pass = 0;
+}
+
+void lottery_ready(Simulation* sim, Task* t, ReadyReason why) {
+    t->prio = sim->virtual_time + random_exponential(sim, t->tickets);
+}
+
+void lottery_ran(Simulation* sim, Task* t, int ran, RunOutcome how) {
+    int q = sim->param;
+    t->tickets = (how == RAN_SLICE_EXPIRED || ran <= 0) ? TICKETS : TICKETS * (long)q / (ran < q ? ran : q);
+}
+
+// Stride: least pass first; a run advances the pass by the task's stride in
+// proportion to the quantum used. A task rejoining the queue starts no
+// further back than the current pass.
+void stride_ready(Simulation* sim, Task* t, ReadyReason why) {
+    if ((why == READY_ARRIVAL || why == READY_IO) && t->pass < sim->virtual_time)
+        t->pass = sim->virtual_time;
+    t->prio = t->pass;
+}
+
+void stride_ran(Simulation* sim, Task* t, int ran, RunOutcome how) {
+    t->pass += (double)STRIDE1 / t->tickets * ran / sim->param;
+}
+
+// EDF: earliest deadline first, preemptive; a CPU burst is due param times
+// its length after it becomes ready
+void edf_init(Simulation* sim, Task* t) {
+    t->deadline = 0;
+}
+
+void edf_ready(Simulation* sim, Task* t, ReadyReason why) {
+    if (why == READY_ARRIVAL || why == READY_IO)
+        t->deadline = sim->system_time + sim->param * t->time_left;
+    t->prio = t->deadline;
+}
+
+void edf_ran(Simulation* sim, Task* t, int ran, RunOutcome how) {
+    if (how == RAN_BURST_DONE) {
+        sim->deadline_bursts++;
+        if (sim->system_time > t->deadline)
+            sim->deadline_misses++;
+    }
+}
+
+double edf_running_prio(Simulation* sim, Task* t) {
+    return t->deadline;
+}
+
+const Policy policies[] = {
+    { "fcfs",    "FCFS",    NULL,              0,  NULL,         fifo_ready,    fcfs_slice, NULL,        NULL },
+    { "rr",      "RR",      "q",               10, NULL,         fifo_ready,    rr_slice,   NULL,        NULL },
+    { "sjf",     "SJF",     NULL,              0,  sjf_init,     sjf_ready,     fcfs_slice, sjf_ran,     NULL },
+    { "srtf",    "SRTF",    NULL,              0,  sjf_init,     srtf_ready,    fcfs_slice, sjf_ran,     srtf_prio },
+    { "mlfq",    "MLFQ",    "q",               8,  mlfq_init,    mlfq_ready,    mlfq_slice, mlfq_ran,    mlfq_running_prio },
+    { "cfs",     "CFS",     "target latency",  20, cfs_init,     cfs_ready,     cfs_slice,  cfs_ran,     cfs_running_prio },
+    { "lottery", "Lottery", "q",               10, lottery_init, lottery_ready, rr_slice,   lottery_ran, NULL },
+    { "stride",  "Stride",  "q",               10, lottery_init, stride_ready,  rr_slice,   stride_ran,  NULL },
+    { "edf",     "EDF",     "deadline factor", 4,  edf_init,     edf_ready,     fcfs_slice, edf_ran,     edf_running_prio },
+};
+
+// Event queue ops --> HEAP_ARITY-ary min-heap on (time, order); entries
+// move into the hole instead of being swapped
+SchedulerEvent make_event(Simulation* sim, long long timestamp, int task_index, EventCategory category) {
+    SchedulerEvent evt = {
+        .time = timestamp,
+        .order = (uint32_t)(category == EVT_PREEMPT) << 31
+               | (uint32_t)sim->tasks[task_index].info->task_id,
+        .task_index = task_index,
+        .category = category,
+        .gen = sim->tasks[task_index].gen
+    };
+    return evt;
+}
+
+// Whether event a is handled before event b
+int event_before(const SchedulerEvent* a, const SchedulerEvent* b) {
+    return a->time < b->time || (a->time == b->time && a->order < b->order);
+}
+
+void event_queue_push(Simulation* sim, SchedulerEvent evt) {
+    if (sim->queue_size == sim->queue_capacity)
+        sim->event_queue = grow_array(sim->event_queue, &sim->queue_capacity, sizeof(SchedulerEvent));
     
-    int pos = queue_size++;
-    event_queue[pos] = evt;
+    SchedulerEvent* heap = sim->event_queue;
+    int pos = sim->queue_size++;
     
     // Bubble up
     while (pos > 0) {
-        int parent = (pos - 1) / 2;
-        if (compare_events(&event_queue[parent], &event_queue[pos]) > 0) {
-            swap_events(&event_queue[parent], &event_queue[pos]);
-            pos = parent;
-        } else {
+        int parent = (pos - 1) / HEAP_ARITY;
+        if (!event_before(&evt, &heap[parent]))
             break;
-        }
+        heap[pos] = heap[parent];
+        pos = parent;
     }
+    heap[pos] = evt;
 }
 
-SchedulerEvent event_queue_pop() {
-    if (queue_size == 0) {
+SchedulerEvent event_queue_pop(Simulation* sim) {
+    if (sim->queue_size == 0) {
         printf("Error: Event queue underflow\n");
         exit(1);
     }
     
-    SchedulerEvent result = event_queue[0];
-    queue_size--;
+    SchedulerEvent* heap = sim->event_queue;
+    SchedulerEvent result = heap[0];
+    int size = --sim->queue_size;
+    SchedulerEvent last = heap[size];
     
-    if (queue_size > 0) {
-        event_queue[0] = event_queue[queue_size];
-        
-        // Sink down
-        int pos = 0;
-        while (1) {
-            int min_pos = pos;
-            int left = 2 * pos + 1;
-            int right = 2 * pos + 2;
-            
-            if (left < queue_size && 
-                compare_events(&event_queue[left], &event_queue[min_pos]) < 0)
-                min_pos = left;
-                
-            if (right < queue_size && 
-                compare_events(&event_queue[right], &event_queue[min_pos]) < 0)
-                min_pos = right;
-                
-            if (min_pos == pos)
-                break;
-                
-            swap_events(&event_queue[pos], &event_queue[min_pos]);
-            pos = min_pos;
+    // Sink down
+    int pos = 0;
+    while (1) {
+        int first = HEAP_ARITY * pos + 1;
+        if (first >= size)
+            break;
+        int end = first + HEAP_ARITY < size ? first + HEAP_ARITY : size;
+        int min_pos = first;
+        for (int c = first + 1; c < end; c++) {
+            if (event_before(&heap[c], &heap[min_pos]))
+                min_pos = c;
         }
+        if (!event_before(&heap[min_pos], &last))
+            break;
+        heap[pos] = heap[min_pos];
+        pos = min_pos;
     }
+    if (size > 0)
+        heap[pos] = last;
     
     return result;
 }
 
-// Task init
-void initialize_tasks() {
-    FILE* input = fopen("proc.txt", "r");
-    if (!input) {
-        printf("Failed to open proc.txt\n");
+// Next integer of the input; much faster than fscanf on large files
+long long read_number(FILE* input, const char* file) {
+    int c = getc_unlocked(input);
+    while (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        c = getc_unlocked(input);
+    int negative = (c == '-');
+    if (negative)
+        c = getc_unlocked(input);
+    if (c < '0' || c > '9') {
+        printf("Error: Malformed %s\n", file);
         exit(1);
     }
+    long long v = 0;
+    while (c >= '0' && c <= '9') {
+        v = 10 * v + (c - '0');
+        c = getc_unlocked(input);
+    }
+    return negative ? -v : v;
+}
 
-    fscanf(input, "%d", &task_count);
-    for (int i = 0; i < task_count; i++) {
-        Task* t = &task_list[i];
-        t->status = PROC_INIT;
-        fscanf(input, "%d %d", &t->task_id, &t->start_time);
-        
-        t->activity_time = 0;
-        int j = 0;
-        while (1) {
-            fscanf(input, "%d", &t->compute_times[j]);
-            t->activity_time += t->compute_times[j];
-            fscanf(input, "%d", &t->wait_times[j]);
-            if (t->wait_times[j] == -1) break;
-            t->activity_time += t->wait_times[j];
-            j++;
+// Read a task's line into t, appending its CPU/IO burst pairs to *bursts
+// (which holds *size of *capacity ints); t->bursts is left unset
+void read_task(FILE* input, const char* file, TaskInfo* t, int** bursts, long* size, long* capacity) {
+    t->task_id = (int)read_number(input, file);
+    t->start_time = read_number(input, file);
+    t->burst_base = *size;
+    
+    t->activity_time = 0;
+    int j = 0;
+    while (1) {
+        if (*size + 2 > *capacity) {
+            *capacity = *capacity ? 2 * *capacity : 16;
+            *bursts = realloc(*bursts, *capacity * sizeof(int));
+            if (!*bursts) {
+                printf("Error: Out of memory\n");
+                exit(1);
+            }
         }
-        t->burst_count = j + 1;
-        t->burst_index = 0;
-        t->time_left = t->compute_times[0];
-        t->queue_time = 0;
+        int cpu = (*bursts)[(*size)++] = (int)read_number(input, file);
+        int io = (*bursts)[(*size)++] = (int)read_number(input, file);
+        t->activity_time += cpu;
+        if (io == -1) break;
+        t->activity_time += io;
+        j++;
+    }
+    t->burst_count = j + 1;
+    if (t->task_id < 0) {
+        printf("Error: Negative process id %d\n", t->task_id);
+        exit(1);
+    }
+}
+
+FILE* open_input(const char* file) {
+    FILE* input = strcmp(file, "-") == 0 ? stdin : fopen(file, "r");
+    if (!input) {
+        printf("Failed to open %s\n", file);
+        exit(1);
     }
-    fclose(input);
+    return input;
 }
 
-void check_idle_state() {
+// Read w->file
+void load_workload(Workload* w) {
+    FILE* input = open_input(w->file);
+
+    w->task_count = (int)read_number(input, w->file);
+    w->tasks = malloc((w->task_count > 0 ? w->task_count : 1) * sizeof(TaskInfo));
+    w->burst_arena = NULL;
+    long arena_capacity = 0;
+    long arena_size = 0;
+    if (!w->tasks) {
+        printf("Error: Out of memory\n");
+        exit(1);
+    }
+    for (int i = 0; i < w->task_count; i++) {
+        TaskInfo* t = &w->tasks[i];
+        read_task(input, w->file, t, &w->burst_arena, &arena_size, &arena_capacity);
+    }
+    if (input != stdin)
+        fclose(input);
+    for (int i = 0; i < w->task_count; i++)
+        w->tasks[i].bursts = &w->burst_arena[w->tasks[i].burst_base];
+}
+
+void check_idle_state(Simulation* sim, int core) {
     #ifdef VERBOSE
-    if (running_task == -1 && is_ready_queue_empty()) {
-        printf("%d : CPU goes idle\n", system_time);
+    if (sim->cores[core].running == -1 && is_ready_queue_empty(core_queue(sim, core))) {
+        if (sim->core_count == 1)
+            printf("%lld : CPU goes idle\n", sim->system_time);
+        else
+            printf("%lld : Core %d goes idle\n", sim->system_time, core);
     }
     #endif
 }
 
-void schedule_next_task(int quantum) {
-    if (running_task != -1 || is_ready_queue_empty()) 
+// The core a task ran on becomes free
+void release_core(Simulation* sim, Task* t) {
+    sim->cores[t->core].running = -1;
+    sim->cores[t->core].idle_since = sim->system_time;
+    t->last_ran = sim->system_time;
+}
+
+// Queue a task under the policy; returns the core whose queue took it
+int enqueue_task(Simulation* sim, int task_index, ReadyReason why) {
+    int core = pick_core(sim, task_index);
+    sim->policy->ready(sim, &sim->tasks[task_index], why);
+    ready_queue_enqueue(sim, core_queue(sim, core), task_index);
+    return core;
+}
+
+// Stop the task running on a core; its pending event becomes stale
+void preempt_core(Simulation* sim, int core) {
+    int task_index = sim->cores[core].running;
+    Task* t = &sim->tasks[task_index];
+    int ran = sim->system_time > t->run_start ? (int)(sim->system_time - t->run_start) : 0;
+    t->time_left -= ran;
+    t->gen++;
+    if (sim->policy->ran)
+        sim->policy->ran(sim, t, ran, RAN_PREEMPTED);
+    release_core(sim, t);
+    #ifdef VERBOSE
+    printf("%lld : Process %d is preempted\n", sim->system_time, t->info->task_id);
+    #endif
+    enqueue_task(sim, task_index, READY_PREEMPTED);
+}
+
+// A task becomes ready. Under a preemptive policy it takes the core whose
+// running task has the worst priority, if that is worse than its own.
+void make_ready(Simulation* sim, int task_index, ReadyReason why) {
+    int target = enqueue_task(sim, task_index, why);
+    if (!sim->policy->running_prio)
         return;
-    
-    int next_task = ready_queue_dequeue();
-    running_task = next_task;
-    Task* t = &task_list[next_task];
+
+    int victim = -1;
+    double worst = 0;
+    for (int c = 0; c < sim->core_count; c++) {
+        if (sim->balance == BAL_STEAL && c != target)
+            continue;
+        if (sim->cores[c].running == -1)
+            return;  // An idle core takes it without preempting anyone
+        double p = sim->policy->running_prio(sim, &sim->tasks[sim->cores[c].running]);
+        if (victim == -1 || p > worst) {
+            victim = c;
+            worst = p;
+        }
+    }
+    if (victim != -1 && sim->tasks[task_index].prio < worst)
+        preempt_core(sim, victim);
+}
+
+void schedule_next_task(Simulation* sim, int core) {
+    Core* c = &sim->cores[core];
+    if (c->running != -1)
+        return;
+
+    int next_task = ready_queue_dequeue(sim, core_queue(sim, core));
+    if (next_task == -1 && sim->balance == BAL_STEAL)
+        next_task = steal_task(sim, core);
+    if (next_task == -1)
+        return;
+
+    c->running = next_task;
+    c->idle_time += sim->system_time - c->idle_since;
+    Task* t = &sim->tasks[next_task];
     t->status = PROC_ACTIVE;
+
+    // A task that last ran elsewhere first pays the migration cost
+    int overhead = 0;
+    if (t->core != -1 && t->core != core) {
+        overhead = sim->migration_cost;
+        c->migrations++;
+        c->migration_time += overhead;
+    }
+
+    // Switching the core to another task costs a context switch, and the
+    // task then refills its cache: the longer since it last ran, the more
+    // of it has been evicted (all of it before its first run)
+    if (c->last_task != next_task) {
+        c->switches++;
+        c->switch_time += sim->switch_cost;
+        overhead += sim->switch_cost;
+        if (sim->refill_max > 0) {
+            double cold = t->last_ran < 0 ? 1 : 1 - exp(-(sim->system_time - t->last_ran) / sim->refill_tau);
+            int refill = (int)(sim->refill_max * cold + 0.5);
+            c->refill_time += refill;
+            overhead += refill;
+        }
+        c->last_task = next_task;
+    }
+    if (t->core == -1)  // First run: response time
+        hist_record(&sim->response_hist, sim->system_time - t->info->start_time);
+    t->core = core;
+    t->run_start = sim->system_time + overhead;
+
+    int slice = sim->policy->slice(sim, t);
+    int duration = slice < t->time_left ? slice : t->time_left;
     
-    int duration = quantum < t->time_left ? quantum : t->time_left;
+    SchedulerEvent next_evt = make_event(sim, sim->system_time + overhead + duration, next_task,
+                                         (duration == t->time_left) ? EVT_COMPLETE : EVT_PREEMPT);
     
-    SchedulerEvent next_evt = {
-        .timestamp = system_time + duration,
-        .task_index = next_task,
-        .category = (duration == t->time_left) ? EVT_COMPLETE : EVT_PREEMPT
-    };
+    #ifdef VERBOSE
+    if (sim->core_count == 1)
+        printf("%lld : Process %d is scheduled to run for time %d\n",
+               sim->system_time, t->info->task_id, duration);
+    else
+        printf("%lld : Process %d is scheduled to run for time %d on core %d\n",
+               sim->system_time, t->info->task_id, duration, core);
+    #endif
     
+    event_queue_push(sim, next_evt);
+}
+
+// Shared IO devices (-d): a task's requests go to device task_id % n, each
+// at a track hashed from the task and burst, and queue while it is busy
+IoDevice* task_device(Simulation* sim, Task* t) {
+    return &sim->devices[t->info->task_id % sim->io_devices];
+}
+
+// Serve the device's next request, if it is idle and has one
+void io_start_next(Simulation* sim, IoDevice* d) {
+    if (d->busy != -1 || d->head == -1)
+        return;
+
+    int pick = d->head, pick_prev = -1;
+    if (sim->io_discipline == IO_ELEVATOR) {
+        pick = -1;
+        for (int pass = 0; pass < 2 && pick == -1; pass++) {
+            int best = INT_MAX;
+            for (int i = d->head, prev = -1; i != -1; prev = i, i = sim->tasks[i].io_next) {
+                int ahead = d->up ? sim->tasks[i].io_track - d->track : d->track - sim->tasks[i].io_track;
+                if (ahead >= 0 && ahead < best) {  // Oldest first on the same track
+                    best = ahead;
+                    pick = i;
+                    pick_prev = prev;
+                }
+            }
+            if (pick == -1)
+                d->up = !d->up;
+        }
+    }
+
+    Task* t = &sim->tasks[pick];
+    if (pick_prev == -1)
+        d->head = t->io_next;
+    else
+        sim->tasks[pick_prev].io_next = t->io_next;
+    if (d->tail == pick)
+        d->tail = pick_prev;
+    d->queued--;
+
+    int distance = t->io_track > d->track ? t->io_track - d->track : d->track - t->io_track;
+    int seek = (int)((long long)sim->seek_max * distance / (IO_TRACKS - 1));
+    int io = IO_BURST(t, t->burst_index - 1);
+    d->busy = pick;
+    d->track = t->io_track;
+    d->requests++;
+    d->seek_time += seek;
+    d->busy_time += seek + io;
+    d->wait_time += sim->system_time - t->io_queued;
     #ifdef VERBOSE
-    printf("%d : Process %d is scheduled to run for time %d\n",
-           system_time, t->task_id, duration);
+    printf("%lld : Process %d starts IO on device %d\n",
+           sim->system_time, t->info->task_id, (int)(d - sim->devices));
     #endif
+    event_queue_push(sim, make_event(sim, sim->system_time + seek + io, pick, EVT_UNBLOCK));
+}
+
+// A task that finished a CPU burst queues for its IO device
+void io_submit(Simulation* sim, int task_index) {
+    Task* t = &sim->tasks[task_index];
+    IoDevice* d = task_device(sim, t);
+    uint64_t h = ((uint64_t)t->info->task_id << 32 | (uint32_t)t->burst_index) * 0x9E3779B97F4A7C15ull;
+    t->io_track = (int)((h >> 32) % IO_TRACKS);
+    t->io_next = -1;
+    t->io_queued = sim->system_time;
+    if (d->tail == -1)
+        d->head = task_index;
+    else
+        sim->tasks[d->tail].io_next = task_index;
+    d->tail = task_index;
+    if (++d->queued > d->queue_max)
+        d->queue_max = d->queued;
+    io_start_next(sim, d);
+}
+
+// Set up task i for a run and queue its arrival
+void start_task(Simulation* sim, int i) {
+    Task* t = &sim->tasks[i];
+    t->bursts = t->info->bursts;
+    t->burst_index = 0;
+    t->time_left = CPU_BURST(t, 0);
+    t->queue_time = 0;
+    t->completion_time = 0;
+    t->status = PROC_INIT;
+    t->core = -1;
+    t->last_ran = -1;
+    if (sim->policy->init)
+        sim->policy->init(sim, t);
     
-    event_queue_push(next_evt);
+    event_queue_push(sim, make_event(sim, t->info->start_time, i, EVT_START));
 }
 
-void run_scheduler(int quantum) {
-    printf("**** %s Scheduling %s ****\n",
-           quantum == TIME_INFINITY ? "FCFS" : "RR",
-           quantum == TIME_INFINITY ? "" : quantum == 10 ? "with q = 10" : "with q = 5");
+// Streaming: take a free slot, or add one to the pool
+int alloc_slot(Simulation* sim) {
+    int i = sim->free_slot;
+    if (i != -1) {
+        sim->free_slot = sim->slots[i].next_free;
+        sim->tasks[i].gen++;  // Events left over from the slot's last task are stale
+        return i;
+    }
+    if (sim->task_count == sim->slot_capacity) {
+        long old_capacity = sim->slot_capacity;
+        sim->slots = grow_array(sim->slots, &sim->slot_capacity, sizeof(TaskSlot));
+        memset(&sim->slots[old_capacity], 0, (sim->slot_capacity - old_capacity) * sizeof(TaskSlot));
+        for (int k = 0; k < sim->task_count; k++)
+            sim->tasks[k].info = &sim->slots[k].info;
+    }
+    while (sim->task_capacity < sim->slot_capacity)
+        sim->tasks = grow_array(sim->tasks, &sim->task_capacity, sizeof(Task));
+    i = sim->task_count++;
+    sim->tasks[i].info = &sim->slots[i].info;
+    sim->tasks[i].gen = 0;
+    return i;
+}
+
+void release_slot(Simulation* sim, int i) {
+    for (int c = 0; c < sim->core_count; c++) {
+        if (sim->cores[c].last_task == i)
+            sim->cores[c].last_task = -1;  // The slot's next task is another task
+    }
+    sim->slots[i].next_free = sim->free_slot;
+    sim->free_slot = i;
+    sim->active_tasks--;
+}
+
+// Skip blanks; whether the input has ended
+int at_end(FILE* input) {
+    int c = getc_unlocked(input);
+    while (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        c = getc_unlocked(input);
+    if (c == EOF)
+        return 1;
+    ungetc(c, input);
+    return 0;
+}
+
+// Generated arrivals follow genproc: 90% IO-bound tasks with 4-10 CPU
+// bursts of 1-15, the rest CPU-bound with 3-7 bursts of 100-300; IO bursts
+// of 50-200, and 0-499 between arrivals
+int gen_random(Simulation* sim, int n) {
+    return (int)((xorshift(&sim->gen_rng) >> 11) % n);
+}
+
+void generate_task(Simulation* sim, TaskSlot* slot) {
+    TaskInfo* t = &slot->info;
+    int io_bound = gen_random(sim, 10) != 0;
+    int count = io_bound ? 4 + gen_random(sim, 7) : 3 + gen_random(sim, 5);
+    int cpu_min = io_bound ? 1 : 100, cpu_range = io_bound ? 15 : 201;
+    if (slot->burst_capacity < 2 * count) {
+        slot->burst_capacity = 2 * count;
+        slot->bursts = realloc(slot->bursts, slot->burst_capacity * sizeof(int));
+        if (!slot->bursts) {
+            printf("Error: Out of memory\n");
+            exit(1);
+        }
+    }
+    t->task_id = (int)(sim->work->generate - sim->to_read) + 1;
+    t->start_time = sim->gen_arrival;
+    t->burst_base = 0;
+    t->burst_count = count;
+    t->activity_time = 0;
+    for (int k = 0; k < count; k++) {
+        slot->bursts[2 * k] = cpu_min + gen_random(sim, cpu_range);
+        slot->bursts[2 * k + 1] = k == count - 1 ? -1 : 50 + gen_random(sim, 151);
+        t->activity_time += slot->bursts[2 * k] + (k == count - 1 ? 0 : slot->bursts[2 * k + 1]);
+    }
+    sim->gen_arrival += gen_random(sim, 500);
+}
+
+// Streaming: read or generate the next arrival into a slot and queue it.
+// Arrivals must come in time order; each one is read when the one before
+// it starts, so the pool holds the active tasks and one pending arrival.
+void inject_arrival(Simulation* sim) {
+    if (sim->to_read == 0)
+        return;
+    if (sim->to_read < 0 && at_end(sim->input)) {
+        sim->to_read = 0;
+        return;
+    }
+    int i = alloc_slot(sim);
+    TaskSlot* slot = &sim->slots[i];
+    if (sim->input) {
+        long size = 0;
+        read_task(sim->input, sim->work->file, &slot->info, &slot->bursts, &size, &slot->burst_capacity);
+    } else {
+        generate_task(sim, slot);
+    }
+    slot->info.bursts = slot->bursts;
+    if (sim->to_read > 0)
+        sim->to_read--;
+    if (slot->info.start_time < sim->system_time) {
+        printf("Error: Process %d in %s arrives at %lld, before the previous arrival at %lld\n",
+               slot->info.task_id, sim->work->file, slot->info.start_time, sim->system_time);
+        exit(1);
+    }
+    if (++sim->active_tasks > sim->peak_active)
+        sim->peak_active = sim->active_tasks;
+    start_task(sim, i);
+}
+
+// Run sim->policy on sim->work and fill in sim->result
+void run_scheduler(Simulation* sim) {
+    const Workload* work = sim->work;
 
     #ifdef VERBOSE
     printf("0 : Starting\n");
     #endif
 
     // Initialize system state
-    system_time = 0;
-    idle_periods = 0;
-    queue_size = 0;
-    ready_front = ready_rear = 0;
-    running_task = -1;
+    if (!work->stream && sim->task_capacity < work->task_count) {
+        free(sim->tasks);
+        sim->task_capacity = work->task_count;
+        sim->tasks = malloc(sim->task_capacity * sizeof(Task));
+        if (!sim->tasks) {
+            printf("Error: Out of memory\n");
+            exit(1);
+        }
+    }
+    sim->system_time = 0;
+    sim->queue_size = 0;
+    sim->global_rq.size = 0;
+    sim->ready_seq = 0;
+    sim->ready_count = 0;
+    for (int c = 0; c < sim->core_count; c++) {
+        ReadyQueue rq = sim->cores[c].rq;  // Keep its storage
+        memset(&sim->cores[c], 0, sizeof(Core));
+        sim->cores[c].rq = rq;
+        sim->cores[c].rq.size = 0;
+        sim->cores[c].running = -1;
+        sim->cores[c].last_task = -1;
+    }
+    for (int d = 0; d < sim->io_devices; d++) {
+        memset(&sim->devices[d], 0, sizeof(IoDevice));
+        sim->devices[d].busy = sim->devices[d].head = sim->devices[d].tail = -1;
+        sim->devices[d].up = 1;
+    }
+    sim->virtual_time = 0;
+    sim->next_boost = MLFQ_BOOST;
+    sim->rng = LOTTERY_SEED;
+    sim->deadline_misses = sim->deadline_bursts = 0;
+    sim->wait_total = 0;
+    sim->done_count = 0;
+    memset(&sim->wait_hist, 0, sizeof(Hist));
+    memset(&sim->response_hist, 0, sizeof(Hist));
+    memset(&sim->turnaround_hist, 0, sizeof(Hist));
+    sim->window_time = 0;
     
     // Schedule initial arrivals
-    for (int i = 0; i < task_count; i++) {
-        Task* t = &task_list[i];
-        t->burst_index = 0;
-        t->time_left = t->compute_times[0];
-        t->queue_time = 0;
-        t->completion_time = 0;
-        t->status = PROC_INIT;
-        
-        SchedulerEvent evt = {
-            .timestamp = t->start_time,
-            .task_index = i,
-            .category = EVT_START
-        };
-        event_queue_push(evt);
+    if (work->stream) {
+        sim->task_count = 0;
+        sim->free_slot = -1;
+        sim->active_tasks = sim->peak_active = 0;
+        if (work->generate) {
+            sim->input = NULL;
+            sim->to_read = work->generate;
+            sim->gen_rng = GEN_SEED;
+            sim->gen_arrival = 0;
+        } else {
+            sim->input = open_input(work->file);
+            long n = (long)read_number(sim->input, work->file);
+            sim->to_read = n > 0 ? n : -1;  // A count of 0 reads to the end of the file
+        }
+        inject_arrival(sim);
+    } else {
+        sim->task_count = work->task_count;
+        for (int i = 0; i < work->task_count; i++) {
+            sim->tasks[i].info = &work->tasks[i];
+            sim->tasks[i].gen = 0;
+            start_task(sim, i);
+        }
     }
 
-    int final_time = 0;
+    long long final_time = 0;
+    struct timespec loop_start, loop_end;
+    clock_gettime(CLOCK_MONOTONIC, &loop_start);
+    sim->events_processed = 0;
 
     // Main event loop
-    while (queue_size > 0) {
-        SchedulerEvent evt = event_queue_pop();
-        
-        if (running_task == -1) {
-            idle_periods += evt.timestamp - system_time;
+    while (sim->queue_size > 0) {
+        SchedulerEvent evt = event_queue_pop(sim);
+        sim->events_processed++;
+        if (evt.category == EVT_START && work->stream) {
+            // Before taking a Task pointer: the pool may move
+            sim->system_time = evt.time;
+            inject_arrival(sim);
         }
+        Task* t = &sim->tasks[evt.task_index];
+        if (evt.gen != t->gen)
+            continue;  // The run it ends was preempted
         
-        system_time = evt.timestamp;
-        Task* t = &task_list[evt.task_index];
+        long long system_time = sim->system_time = evt.time;
+        if (sim->windows.out) {
+            int busy = 0;
+            for (int c = 0; c < sim->core_count; c++)
+                busy += sim->cores[c].running != -1;
+            window_advance(&sim->windows, sim->window_time, system_time, sim->ready_count, busy);
+            sim->window_time = system_time;
+        }
 
         switch (evt.category) {
             case EVT_START:
                 #ifdef VERBOSE
-                printf("%d : Process %d joins ready queue upon arrival\n",
-                       system_time, t->task_id);
+                printf("%lld : Process %d joins ready queue upon arrival\n",
+                       system_time, t->info->task_id);
                 #endif
-                ready_queue_enqueue(evt.task_index);
+                make_ready(sim, evt.task_index, READY_ARRIVAL);
                 break;
 
             case EVT_COMPLETE:
-                running_task = -1;
+                release_core(sim, t);
+                if (sim->policy->ran)
+                    sim->policy->ran(sim, t, (int)(system_time - t->run_start), RAN_BURST_DONE);
                 t->burst_index++;
                 
-                if (t->burst_index == t->burst_count) {
+                if (t->burst_index == t->info->burst_count) {
                     t->status = PROC_DONE;
-                    t->completion_time = system_time - t->start_time;
-                    t->queue_time = t->completion_time - t->activity_time;
+                    t->completion_time = system_time - t->info->start_time;
+                    t->queue_time = t->completion_time - t->info->activity_time;
+                    sim->wait_total += t->queue_time;
+                    sim->done_count++;
+                    hist_record(&sim->wait_hist, t->queue_time);
+                    hist_record(&sim->turnaround_hist, t->completion_time);
                     
-                    printf("%d : Process %d exits. Turnaround time = %d (%d%%), Wait time = %d\n",
-                           system_time, t->task_id,
-                           t->completion_time,
-                           (t->completion_time * 100) / t->activity_time,
-                           t->queue_time);
+                    if (!sim->quiet)
+                        printf("%lld : Process %d exits. Turnaround time = %lld (%lld%%), Wait time = %lld\n",
+                               system_time, t->info->task_id,
+                               t->completion_time,
+                               (t->completion_time * 100) / t->info->activity_time,
+                               t->queue_time);
+                    if (work->stream)
+                        release_slot(sim, evt.task_index);
                 } else {
                     t->status = PROC_BLOCKED;
-                    SchedulerEvent unblock = {
-                        .timestamp = system_time + t->wait_times[t->burst_index - 1],
-                        .task_index = evt.task_index,
-                        .category = EVT_UNBLOCK
-                    };
-                    event_queue_push(unblock);
+                    if (sim->io_devices)
+                        io_submit(sim, evt.task_index);
+                    else
+                        event_queue_push(sim, make_event(sim, system_time + IO_BURST(t, t->burst_index - 1),
+                                                         evt.task_index, EVT_UNBLOCK));
                 }
-                check_idle_state();
+                check_idle_state(sim, t->core);
                 break;
 
             case EVT_UNBLOCK:
-                t->time_left = t->compute_times[t->burst_index];
+                if (sim->io_devices) {
+                    IoDevice* d = task_device(sim, t);
+                    d->busy = -1;
+                    io_start_next(sim, d);
+                }
+                t->time_left = CPU_BURST(t, t->burst_index);
                 #ifdef VERBOSE
-                printf("%d : Process %d joins ready queue after IO completion\n",
-                       system_time, t->task_id);
+                printf("%lld : Process %d joins ready queue after IO completion\n",
+                       system_time, t->info->task_id);
                 #endif
-                ready_queue_enqueue(evt.task_index);
+                make_ready(sim, evt.task_index, READY_IO);
                 break;
 
             case EVT_PREEMPT:
-                running_task = -1;
-                t->time_left -= quantum;
+                release_core(sim, t);
+                t->time_left -= (int)(system_time - t->run_start);
+                if (sim->policy->ran)
+                    sim->policy->ran(sim, t, (int)(system_time - t->run_start), RAN_SLICE_EXPIRED);
                 #ifdef VERBOSE
-                printf("%d : Process %d joins ready queue after timeout\n",
-                       system_time, t->task_id);
+                printf("%lld : Process %d joins ready queue after timeout\n",
+                       system_time, t->info->task_id);
                 #endif
-                ready_queue_enqueue(evt.task_index);
+                make_ready(sim, evt.task_index, READY_TIMEOUT);
                 break;
         }
 
-        schedule_next_task(quantum);
+        for (int c = 0; c < sim->core_count; c++)
+            schedule_next_task(sim, c);
         final_time = system_time;
     }
+    clock_gettime(CLOCK_MONOTONIC, &loop_end);
+    if (sim->input && sim->input != stdin)
+        fclose(sim->input);
+    sim->input = NULL;
+    sim->loop_seconds = seconds_between(&loop_start, &loop_end);
+
+    // Every core is idle from its last burst to the end
+    long long idle_periods = 0;
+    long switches = 0;
+    long long overhead = 0;
+    for (int c = 0; c < sim->core_count; c++) {
+        Core* core = &sim->cores[c];
+        core->idle_time += final_time - core->idle_since;
+        idle_periods += core->idle_time;
+        switches += core->switches;
+        overhead += core->switch_time + core->refill_time + core->migration_time;
+    }
+
+    sim->result.avg_wait = (double)sim->wait_total / sim->done_count;
+    sim->result.final_time = final_time;
+    sim->result.idle_time = idle_periods;
+    sim->result.utilization = (100.0 * ((double)sim->core_count * final_time - idle_periods))
+                              / ((double)sim->core_count * final_time);
+    sim->result.switches = switches;
+    sim->result.overhead = overhead;
+    sim->result.useful_utilization = (100.0 * ((double)sim->core_count * final_time - idle_periods - overhead))
+                                     / ((double)sim->core_count * final_time);
+    const double q[3] = { 0.5, 0.95, 0.99 };
+    for (int k = 0; k < 3; k++) {
+        sim->result.wait_q[k] = hist_quantile(&sim->wait_hist, q[k]);
+        sim->result.response_q[k] = hist_quantile(&sim->response_hist, q[k]);
+        sim->result.turnaround_q[k] = hist_quantile(&sim->turnaround_hist, q[k]);
+    }
+    long requests = 0;
+    long long io_wait = 0, io_busy = 0;
+    for (int d = 0; d < sim->io_devices; d++) {
+        requests += sim->devices[d].requests;
+        io_wait += sim->devices[d].wait_time;
+        io_busy += sim->devices[d].busy_time;
+    }
+    sim->result.io_wait = requests ? (double)io_wait / requests : 0;
+    sim->result.io_utilization = sim->io_devices && final_time
+                                 ? 100.0 * io_busy / ((double)sim->io_devices * final_time) : 0;
+    window_finish(&sim->windows, final_time);
+}
 
-    // Print stats
-    double avg_wait = 0;
-    for (int i = 0; i < task_count; i++) {
-        avg_wait += task_list[i].queue_time;
+// -m: start a run's record; its windows are written as the run goes
+void metrics_begin(Simulation* sim) {
+    char param[16] = "";
+    if (sim->policy->param_label)
+        snprintf(param, sizeof(param), "%d", sim->param);
+    if (metrics_json) {
+        fprintf(metrics_out, "%s\n  { \"workload\": \"%s\", \"policy\": \"%s\", \"param\": %s, \"cores\": %d,\n"
+                "    \"window\": %lld, \"windows\": [",
+                metrics_runs ? "," : "", sim->work->file, sim->policy->name, param[0] ? param : "null",
+                sim->core_count, window_width);
     }
-    avg_wait /= task_count;
+    snprintf(sim->label, sizeof(sim->label), "%s,%s,%s", sim->work->file, sim->policy->name, param);
+    window_init(&sim->windows, metrics_out, metrics_json, sim->label, window_width, sim->core_count);
+    metrics_runs++;
+}
+
+void metrics_hist_json(const char* name, Hist* h, const char* sep) {
+    fprintf(metrics_out, "    \"%s\": { \"count\": %llu, \"mean\": %.2f, \"p50\": %.0f, \"p95\": %.0f, \"p99\": %.0f, \"max\": %llu }%s\n",
+            name, (unsigned long long)h->count, hist_mean(h), hist_quantile(h, 0.5), hist_quantile(h, 0.95),
+            hist_quantile(h, 0.99), (unsigned long long)h->max, sep);
+}
+
+// -m: finish the run's record with its per-task distributions
+void metrics_end(Simulation* sim) {
+    if (metrics_json) {
+        fprintf(metrics_out, "\n    ],\n");
+        metrics_hist_json("wait", &sim->wait_hist, ",");
+        metrics_hist_json("response", &sim->response_hist, ",");
+        metrics_hist_json("turnaround", &sim->turnaround_hist, "");
+        fprintf(metrics_out, "  }");
+    }
+    sim->windows.out = NULL;
+}
 
-    printf("Average wait time = %.2f\n", avg_wait);
-    printf("Total turnaround time = %d\n", final_time);
-    printf("CPU idle time = %d\n", idle_periods);
-    printf("CPU utilization = %.2f%%\n", 
-           (100.0 * (final_time - idle_periods)) / final_time);
+void print_quantiles(const char* name, Hist* h) {
+    printf("%s: mean = %.2f, p50 = %.0f, p95 = %.0f, p99 = %.0f, max = %llu\n", name, hist_mean(h),
+           hist_quantile(h, 0.5), hist_quantile(h, 0.95), hist_quantile(h, 0.99), (unsigned long long)h->max);
+}
+
+void print_header(Simulation* sim) {
+    printf("**** %s Scheduling ", sim->policy->title);
+    if (sim->policy->param_label)
+        printf("with %s = %d ", sim->policy->param_label, sim->param);
+    else
+        printf(" ");
+    if (sim->core_count > 1)
+        printf("on %d cores (%s) ", sim->core_count, sim->balance == BAL_GLOBAL ? "global queue" : "work stealing");
+    if (sim->io_devices)
+        printf("with %d IO device%s (%s, seek %d) ", sim->io_devices, sim->io_devices > 1 ? "s" : "",
+               sim->io_discipline == IO_FIFO ? "FIFO" : "elevator", sim->seek_max);
+    printf("****\n");
+}
+
+// Print stats
+void print_report(Simulation* sim) {
+    RunResult* r = &sim->result;
+    printf("Average wait time = %.2f\n", r->avg_wait);
+    printf("Total turnaround time = %lld\n", r->final_time);
+    printf("CPU idle time = %lld\n", r->idle_time);
+    printf("CPU utilization = %.2f%%\n", r->utilization);
+    if (sim->switch_cost > 0 || sim->refill_max > 0) {
+        long long switch_time = 0, refill_time = 0;
+        for (int c = 0; c < sim->core_count; c++) {
+            switch_time += sim->cores[c].switch_time;
+            refill_time += sim->cores[c].refill_time;
+        }
+        printf("Context switches = %ld (time lost %lld), cache refill time lost = %lld\n",
+               r->switches, switch_time, refill_time);
+        printf("Useful CPU utilization = %.2f%%\n", r->useful_utilization);
+    }
+    if (sim->core_count > 1) {
+        for (int c = 0; c < sim->core_count; c++) {
+            printf("    Core %d: utilization = %.2f%%, migrations = %d (time lost %lld)\n", c,
+                   (100.0 * (r->final_time - sim->cores[c].idle_time)) / r->final_time,
+                   sim->cores[c].migrations, sim->cores[c].migration_time);
+        }
+    }
+    if (sim->io_devices) {
+        printf("IO wait = %.2f per request, IO utilization = %.2f%%\n", r->io_wait, r->io_utilization);
+        if (sim->io_devices > 1) {
+            for (int d = 0; d < sim->io_devices; d++) {
+                IoDevice* dev = &sim->devices[d];
+                printf("    Device %d: utilization = %.2f%%, requests = %ld, longest queue = %d, seek time = %lld\n", d,
+                       (100.0 * dev->busy_time) / r->final_time, dev->requests, dev->queue_max, dev->seek_time);
+            }
+        }
+    }
+    if (sim->policy->ran == edf_ran)
+        printf("Deadline misses = %ld of %ld CPU bursts\n", sim->deadline_misses, sim->deadline_bursts);
+    if (sim->work->stream)
+        printf("Processes = %ld, at most %d in memory\n", sim->done_count, sim->peak_active);
+    if (metrics_out) {
+        print_quantiles("Wait time", &sim->wait_hist);
+        print_quantiles("Response time", &sim->response_hist);
+        print_quantiles("Turnaround time", &sim->turnaround_hist);
+    }
+    if (sim->quiet) {
+        // Event-loop throughput, kept off stdout so the report stays comparable
+        double secs = sim->loop_seconds;
+        fprintf(stderr, "%ld events in %.3f s (%.0f events/s)\n", sim->events_processed, secs,
+                secs > 0 ? sim->events_processed / secs : 0.0);
+    }
     printf("\n");
 }
 
-int main() {
-    initialize_tasks();
-    run_scheduler(TIME_INFINITY);  // FCFS
-    run_scheduler(10);            // RR with q=10
-    run_scheduler(5);             // RR with q=5
+// A simulation set up from the command line, with no storage yet
+void init_simulation(Simulation* sim) {
+    memset(sim, 0, sizeof(Simulation));
+    sim->core_count = core_count;
+    sim->balance = balance;
+    sim->migration_cost = migration_cost;
+    sim->switch_cost = switch_cost;
+    sim->refill_max = refill_max;
+    sim->refill_tau = refill_tau;
+    sim->quiet = quiet;
+    sim->io_devices = io_devices;
+    sim->io_discipline = io_discipline;
+    sim->seek_max = seek_max;
+}
+
+void free_simulation(Simulation* sim) {
+    for (long i = 0; i < sim->slot_capacity; i++)
+        free(sim->slots[i].bursts);
+    free(sim->slots);
+    free(sim->tasks);
+    free(sim->event_queue);
+    free(sim->global_rq.items);
+    for (int c = 0; c < CORE_LIMIT; c++)
+        free(sim->cores[c].rq.items);
+}
+
+// Parameter sweep: one job per (workload, policy run). Worker threads take
+// jobs in turn from a shared counter, each with its own Simulation.
+typedef struct {
+    const Workload* work;
+    const PolicyRun* run;
+    RunResult result;
+} SweepJob;
+
+SweepJob* jobs;
+long job_count;
+long next_job = 0;
+
+void* sweep_worker(void* arg) {
+    Simulation sim;
+    init_simulation(&sim);
+    sim.quiet = 1;
+    while (1) {
+        long j = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED);
+        if (j >= job_count)
+            break;
+        sim.work = jobs[j].work;
+        sim.policy = jobs[j].run->policy;
+        sim.param = jobs[j].run->param;
+        run_scheduler(&sim);
+        jobs[j].result = sim.result;
+    }
+    free_simulation(&sim);
+    return NULL;
+}
+
+// Run every job on thread_count threads, then print a CSV line per job in
+// command-line order
+void run_sweep(int thread_count) {
+    job_count = (long)workload_count * run_count;
+    jobs = malloc(job_count * sizeof(SweepJob));
+    if (!jobs) {
+        printf("Error: Out of memory\n");
+        exit(1);
+    }
+    for (int w = 0; w < workload_count; w++) {
+        for (int r = 0; r < run_count; r++) {
+            jobs[(long)w * run_count + r].work = &workloads[w];
+            jobs[(long)w * run_count + r].run = &runs[r];
+        }
+    }
+    if (thread_count > job_count)
+        thread_count = (int)job_count;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t threads[THREAD_LIMIT];
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&threads[i], NULL, sweep_worker, NULL) != 0) {
+            printf("Error: Cannot create thread %d\n", i);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < thread_count; i++)
+        pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("workload,policy,param,cores,balance,avg_wait,turnaround,cpu_idle,utilization,"
+           "switches,overhead,useful_utilization,wait_p50,wait_p95,wait_p99,"
+           "response_p50,response_p95,response_p99,turnaround_p50,turnaround_p95,turnaround_p99,io_wait,io_utilization\n");
+    for (long j = 0; j < job_count; j++) {
+        const PolicyRun* run = jobs[j].run;
+        RunResult* r = &jobs[j].result;
+        printf("%s,%s,", jobs[j].work->file, run->policy->name);
+        if (run->policy->param_label)
+            printf("%d", run->param);
+        printf(",%d,%s,%.2f,%lld,%lld,%.2f,%ld,%lld,%.2f", core_count, balance == BAL_GLOBAL ? "global" : "steal",
+               r->avg_wait, r->final_time, r->idle_time, r->utilization,
+               r->switches, r->overhead, r->useful_utilization);
+        for (int k = 0; k < 3; k++)
+            printf(",%.0f", r->wait_q[k]);
+        for (int k = 0; k < 3; k++)
+            printf(",%.0f", r->response_q[k]);
+        for (int k = 0; k < 3; k++)
+            printf(",%.0f", r->turnaround_q[k]);
+        printf(",%.2f,%.2f\n", r->io_wait, r->io_utilization);
+    }
+    fprintf(stderr, "%ld runs on %d threads in %.3f s\n", job_count, thread_count,
+            seconds_between(&start, &end));
+    free(jobs);
+}
+
+// Parse name, name:param or name:first-last; adds a run for every parameter
+int parse_policy(const char* arg) {
+    const char* colon = strchr(arg, ':');
+    size_t len = colon ? (size_t)(colon - arg) : strlen(arg);
+    for (size_t k = 0; k < sizeof(policies) / sizeof(policies[0]); k++) {
+        if (strlen(policies[k].name) == len && strncmp(arg, policies[k].name, len) == 0) {
+            int first = policies[k].param_default, last = first;
+            if (colon) {
+                char* end;
+                if (!policies[k].param_label)
+                    return 0;
+                first = last = (int)strtol(colon + 1, &end, 10);
+                if (*end == '-')
+                    last = (int)strtol(end + 1, &end, 10);
+                if (end == colon + 1 || *end != '\0' || first < 1 || last < first)
+                    return 0;
+            }
+            for (int p = first; p <= last; p++) {
+                if (run_count == run_capacity)
+                    runs = grow_array(runs, &run_capacity, sizeof(PolicyRun));
+                runs[run_count].policy = &policies[k];
+                runs[run_count].param = p;
+                run_count++;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// A proc file, or with generate > 0 that many generated tasks
+void add_workload(const char* file, long generate) {
+    if (workload_count == workload_capacity)
+        workloads = grow_array(workloads, &workload_capacity, sizeof(Workload));
+    Workload* w = &workloads[workload_count++];
+    memset(w, 0, sizeof(Workload));
+    w->file = file;
+    w->generate = generate;
+}
+
+int main(int argc, char* argv[]) {
+    int thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int io_discipline_set = 0;
+    int window_set = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:b:M:x:W:T:d:i:p:f:sg:m:w:qSj:")) != -1) {
+        switch (opt) {
+            case 'c':
+                core_count = atoi(optarg);
+                if (core_count < 1 || core_count > CORE_LIMIT) {
+                    printf("Error: Number of cores must be between 1 and %d\n", CORE_LIMIT);
+                    exit(1);
+                }
+                break;
+            case 'b':
+                if (strcmp(optarg, "global") == 0) balance = BAL_GLOBAL;
+                else if (strcmp(optarg, "steal") == 0) balance = BAL_STEAL;
+                else {
+                    printf("Error: Unknown balancing mode %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'M':
+                migration_cost = atoi(optarg);
+                break;
+            case 'x':
+                switch_cost = atoi(optarg);
+                break;
+            case 'W':
+                refill_max = atoi(optarg);
+                break;
+            case 'T':
+                refill_tau = atof(optarg);
+                if (refill_tau <= 0) {
+                    printf("Error: Cache cooling time must be positive\n");
+                    exit(1);
+                }
+                break;
+            case 'd':
+                io_devices = atoi(optarg);
+                if (io_devices < 1 || io_devices > DEVICE_LIMIT) {
+                    printf("Error: Number of IO devices must be between 1 and %d\n", DEVICE_LIMIT);
+                    exit(1);
+                }
+                break;
+            case 'i': {
+                const char* colon = strchr(optarg, ':');
+                size_t len = colon ? (size_t)(colon - optarg) : strlen(optarg);
+                if (len == 4 && strncmp(optarg, "fifo", 4) == 0) io_discipline = IO_FIFO;
+                else if (len == 8 && strncmp(optarg, "elevator", 8) == 0) io_discipline = IO_ELEVATOR;
+                else {
+                    printf("Error: Unknown IO discipline %s\n", optarg);
+                    exit(1);
+                }
+                io_discipline_set = 1;
+                seek_max = colon ? atoi(colon + 1) : 0;
+                if (seek_max < 0) {
+                    printf("Error: Seek time must not be negative\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'p':
+                if (!parse_policy(optarg)) {
+                    printf("Error: Unknown policy %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'f':
+                add_workload(optarg, 0);
+                break;
+            case 's':
+                stream = 1;
+                break;
+            case 'g': {
+                long n = atol(optarg);
+                if (n < 1) {
+                    printf("Error: Number of generated processes must be positive\n");
+                    exit(1);
+                }
+                char* name = malloc(32);
+                snprintf(name, 32, "gen:%ld", n);
+                add_workload(name, n);
+                break;
+            }
+            case 'm': {
+                size_t len = strlen(optarg);
+                metrics_json = len > 5 && strcmp(optarg + len - 5, ".json") == 0;
+                metrics_out = fopen(optarg, "w");
+                if (!metrics_out) {
+                    printf("Failed to open %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+            case 'w':
+                window_width = atoll(optarg);
+                if (window_width < 1) {
+                    printf("Error: Window width must be positive\n");
+                    exit(1);
+                }
+                window_set = 1;
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            case 'S':
+                sweep = 1;
+                break;
+            case 'j':
+                thread_count = atoi(optarg);
+                if (thread_count < 1 || thread_count > THREAD_LIMIT) {
+                    printf("Error: Number of threads must be between 1 and %d\n", THREAD_LIMIT);
+                    exit(1);
+                }
+                break;
+            default:
+                printf("Usage: %s [-f proc_file]... [-s] [-g count]... [-q] [-c cores] [-b global|steal] [-M migration_cost]\n"
+                       "       [-x switch_cost] [-W refill_max [-T refill_tau]] [-d io_devices [-i fifo|elevator[:seek]]]\n"
+                       "       [-m metrics.csv|metrics.json [-w window]]\n"
+                       "       [-S [-j threads]] [-p policy[:param[-last]]]...\n"
+                       "Policies: fcfs, rr:q, sjf, srtf, mlfq:q, cfs:latency, lottery:q, stride:q, edf:factor\n",
+                       argv[0]);
+                exit(1);
+        }
+    }
+    if (io_discipline_set && io_devices == 0) {
+        printf("Error: -i orders the queues of shared IO devices; give their number with -d\n");
+        exit(1);
+    }
+    if (window_set && !metrics_out) {
+        printf("Error: -w sets the metrics window; give the output file with -m\n");
+        exit(1);
+    }
+    if (run_count == 0) {  // FCFS, RR with q=10, RR with q=5
+        parse_policy("fcfs");
+        parse_policy("rr:10");
+        parse_policy("rr:5");
+    }
+    if (workload_count == 0)
+        add_workload("proc.txt", 0);
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > THREAD_LIMIT)
+        thread_count = THREAD_LIMIT;
+
+    for (int w = 0; w < workload_count; w++) {
+        Workload* work = &workloads[w];
+        if (work->generate || stream) {
+            work->stream = 1;
+            if (strcmp(work->file, "-") == 0 && (run_count > 1 || sweep)) {
+                printf("Error: Standard input can be streamed to one run only\n");
+                exit(1);
+            }
+        } else {
+            load_workload(work);
+        }
+    }
+
+    if (sweep) {
+        if (metrics_out) {
+            printf("Error: -m records single runs; a sweep reports quantiles in its CSV\n");
+            exit(1);
+        }
+        run_sweep(thread_count);
+        return 0;
+    }
+    if (metrics_out) {
+        if (metrics_json)
+            fprintf(metrics_out, "[");
+        else
+            fprintf(metrics_out, "workload,policy,param,window_start,ready_avg,ready_max,utilization\n");
+    }
+
+    Simulation sim;
+    init_simulation(&sim);
+    for (int w = 0; w < workload_count; w++) {
+        sim.work = &workloads[w];
+        if (workload_count > 1)
+            printf("==== %s ====\n\n", sim.work->file);
+        for (int r = 0; r < run_count; r++) {
+            sim.policy = runs[r].policy;
+            sim.param = runs[r].param;
+            print_header(&sim);
+            if (metrics_out)
+                metrics_begin(&sim);
+            run_scheduler(&sim);
+            if (metrics_out)
+                metrics_end(&sim);
+            print_report(&sim);
+        }
+    }
+    free_simulation(&sim);
+    if (metrics_out) {
+        if (metrics_json)
+            fprintf(metrics_out, "\n]\n");
+        fclose(metrics_out);
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "reqring.h"
+#include "park.h"
+
+#ifdef __APPLE__
+#include "pthread_barrier.h"
+#endif
+
+// Request handoff benchmark: n user threads each send r requests of m
+// resource types to one master thread, which acknowledges every request.
+//   barrier: the old protocol of resource.cpp, one global request slot
+//            guarded by a mutex, a request barrier and a per-thread ack barrier
+//   ring:    the MPSC request ring, completion signalled per thread through
+//            a mutex and condition variable
+//   park:    the MPSC request ring, completion published on a futex word
+// Each protocol also reports the context switches it caused per request; the
+// ring protocols also report how many requests the master served per sleep.
+// Usage: bench [n [r [m]]]
+
+int n, r, m;
+long checksum;
+
+// barrier protocol
+pthread_mutex_t rmtx;
+pthread_barrier_t REQB;
+pthread_barrier_t *ACKB;
+Request g_request;
+
+// ring protocol
+ReqRing RQ;
+pthread_mutex_t *cmtx;
+pthread_cond_t *cv;
+bool *done;
+bool use_park;
+Park *parks;
+
+long ctxsw(){
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_nvcsw + ru.ru_nivcsw;
+}
+
+double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void fill(int *req, int tid, int k){
+    for(int j = 0; j < m; j++) req[j] = (tid + k + j) % 5;
+}
+
+void *barrier_user(void *arg){
+    int tid = (int)(long)arg;
+    int *req = (int *)malloc(m * sizeof(int));
+    for(int k = 0; k < r; k++){
+        fill(req, tid, k);
+        pthread_mutex_lock(&rmtx);
+        g_request.type = 0;
+        g_request.thread_id = tid;
+        g_request.request = req;
+        pthread_barrier_wait(&REQB);
+        pthread_barrier_wait(&ACKB[tid]);
+        pthread_mutex_unlock(&rmtx);
+    }
+    free(req);
+    return NULL;
+}
+
+void barrier_master(){
+    for(long k = 0; k < (long)n * r; k++){
+        pthread_barrier_wait(&REQB);
+        for(int j = 0; j < m; j++) checksum += g_request.request[j];
+        pthread_barrier_wait(&ACKB[g_request.thread_id]);
+    }
+}
+
+void *ring_user(void *arg){
+    int tid = (int)(long)arg;
+    int *req = (int *)malloc(m * sizeof(int));
+    for(int k = 0; k < r; k++){
+        fill(req, tid, k);
+        ring_push(&RQ, 0, tid, req, m);
+        if(use_park){
+            park_wait(&parks[tid]);
+            continue;
+        }
+        pthread_mutex_lock(&cmtx[tid]);
+        while(!done[tid]) pthread_cond_wait(&cv[tid], &cmtx[tid]);
+        done[tid] = false;
+        pthread_mutex_unlock(&cmtx[tid]);
+    }
+    free(req);
+    return NULL;
+}
+
+// Returns the number of times the master found the ring empty and slept
+long ring_master(){
+    int *req = (int *)malloc(m * sizeof(int));
+    Request rq;
+    long sleeps = 0;
+    for(long k = 0; k < (long)n * r; ){
+        if(ring_wait(&RQ)) sleeps++;
+        while(ring_pop(&RQ, &rq, req)){
+            for(int j = 0; j < m; j++) checksum += req[j];
+            k++;
+            if(use_park){
+                park_wake(&parks[rq.thread_id]);
+                continue;
+            }
+            pthread_mutex_lock(&cmtx[rq.thread_id]);
+            done[rq.thread_id] = true;
+            pthread_cond_signal(&cv[rq.thread_id]);
+            pthread_mutex_unlock(&cmtx[rq.thread_id]);
+        }
+    }
+    free(req);
+    return sleeps;
+}
+
+// Requests the master served per sleep, for the ring and park lines
+const char *per_sleep(char *buf, size_t len, double total, long sleeps){
+    if(sleeps == 0) snprintf(buf, len, "master never slept");
+    else snprintf(buf, len, "%ld master sleeps, %.1f requests each", sleeps, total / sleeps);
+    return buf;
+}
+
+int main(int argc, char *argv[]){
+    n = (argc > 1) ? atoi(argv[1]) : 100;
+    r = (argc > 2) ? atoi(argv[2]) : 1000;
+    m = (argc > 3) ? atoi(argv[3]) : 10;
+    pthread_t *users = (pthread_t *)malloc(n * sizeof(pthread_t));
+    long total = (long)n * r;
+
+    // barrier protocol
+    pthread_mutex_init(&rmtx, NULL);
+    pthread_barrier_init(&REQB, NULL, 2);
+    ACKB = (pthread_barrier_t *)malloc(n * sizeof(pthread_barrier_t));
+    for(int i = 0; i < n; i++) pthread_barrier_init(&ACKB[i], NULL, 2);
+
+    checksum = 0;
+    long c0 = ctxsw();
+    double t0 = now();
+    for(int i = 0; i < n; i++) pthread_create(&users[i], NULL, barrier_user, (void *)(long)i);
+    barrier_master();
+    for(int i = 0; i < n; i++) pthread_join(users[i], NULL);
+    double tb = now() - t0;
+    long sb = ctxsw() - c0;
+    long cb = checksum;
+
+    // ring protocol
+    ring_init(&RQ, n, m);
+    cmtx = (pthread_mutex_t *)malloc(n * sizeof(pthread_mutex_t));
+    cv = (pthread_cond_t *)malloc(n * sizeof(pthread_cond_t));
+    done = (bool *)calloc(n, sizeof(bool));
+    for(int i = 0; i < n; i++){
+        pthread_mutex_init(&cmtx[i], NULL);
+        pthread_cond_init(&cv[i], NULL);
+    }
+
+    checksum = 0;
+    c0 = ctxsw();
+    t0 = now();
+    for(int i = 0; i < n; i++) pthread_create(&users[i], NULL, ring_user, (void *)(long)i);
+    long sleeps = ring_master();
+    for(int i = 0; i < n; i++) pthread_join(users[i], NULL);
+    double tr = now() - t0;
+    long sr = ctxsw() - c0;
+    long cr = checksum;
+
+    // ring protocol, futex parking
+    parks = new Park[n];
+    for(int i = 0; i < n; i++) park_init(&parks[i]);
+    use_park = true;
+
+    checksum = 0;
+    c0 = ctxsw();
+    t0 = now();
+    for(int i = 0; i < n; i++) pthread_create(&users[i], NULL, ring_user, (void *)(long)i);
+    long psleeps = ring_master();
+    for(int i = 0; i < n; i++) pthread_join(users[i], NULL);
+    double tp = now() - t0;
+    long sp = ctxsw() - c0;
+
+    printf("%d threads x %d requests, %d resource types\n", n, r, m);
+    printf("    barrier: %8.3f s  %10.0f requests/s  %6.2f context switches/request\n",
+           tb, total / tb, (double)sb / total);
+    char buf[64];
+    printf("    ring:    %8.3f s  %10.0f requests/s  %6.2f context switches/request  (%s)\n",
+           tr, total / tr, (double)sr / total, per_sleep(buf, sizeof(buf), total, sleeps));
+    printf("    park:    %8.3f s  %10.0f requests/s  %6.2f context switches/request  (%s)\n",
+           tp, total / tp, (double)sp / total, per_sleep(buf, sizeof(buf), total, psleeps));
+    if(cb != cr || cb != checksum) printf("    checksum mismatch: %ld, %ld, %ld\n", cb, cr, checksum);
+
+    for(int i = 0; i < n; i++){
+        pthread_barrier_destroy(&ACKB[i]);
+        pthread_mutex_destroy(&cmtx[i]);
+        pthread_cond_destroy(&cv[i]);
+    }
+    pthread_barrier_destroy(&REQB);
+    pthread_mutex_destroy(&rmtx);
+    for(int i = 0; i < n; i++) park_destroy(&parks[i]);
+    delete[] parks;
+    ring_destroy(&RQ);
+    free(ACKB); free(cmtx); free(cv); free(done); free(users);
+    return 0;
+}
@@ -1,58 +1,142 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "scenario.h"
+
+/*
+   Usage: geninput [-b] [-s seed] m n [dir]
+
+   Writes dir/system.txt and dir/threadNN.txt, or with -b the packed binary
+   scenario dir/scenario.bin (see scenario.h), which resource maps directly.
+   The same seed gives the same scenario in both forms; without -s the seed
+   is taken from the clock.
+*/
+
+int m, n, bin;
+int32_t *OPS;          /* binary: all ops, SCN_OP_INTS(m) ints each */
+int64_t nops, capops;
+
+static int32_t *newop ( int delay, int kind )
+{
+   int32_t *op;
+
+   if (nops == capops) {
+      capops = capops ? 2 * capops : 1024;
+      OPS = (int32_t *)realloc(OPS, capops * SCN_OP_INTS(m) * sizeof(int32_t));
+      if (OPS == NULL) { fprintf(stderr, "Out of memory\n"); exit(1); }
+   }
+   op = OPS + nops++ * SCN_OP_INTS(m);
+   memset(op, 0, SCN_OP_INTS(m) * sizeof(int32_t));
+   op[0] = delay;
+   op[1] = kind;
+   return op;
+}
 
 int main ( int argc, char *argv[] )
 {
-   int m, n, *TOTAL, *MAX, *ALLOC, i, j, k, nr, rt, req;
-   FILE *fp;
-   char fname[64];
+   int *TOTAL, *MAX, *ALLOC, i, j, k, nr, rt, req, c, delay;
+   int32_t *MAXALL = NULL, *op;
+   int64_t *start = NULL;
+   scn_header hdr;
+   FILE *fp = NULL;
+   char fname[4096];
+   const char *dir;
+   unsigned int seed = (unsigned int)time(NULL);
 
-   if (argc < 3) {
-      fprintf(stderr, "Run with m (number of resources) and n (number of threads)\n");
+   while ((c = getopt(argc, argv, "bs:")) != -1) {
+      if (c == 'b') bin = 1;
+      else if (c == 's') seed = (unsigned int)strtoul(optarg, NULL, 10);
+      else exit(1);
+   }
+   if (argc - optind < 2) {
+      fprintf(stderr, "Run with [-b] [-s seed] m (number of resources) and n (number of threads) [and directory]\n");
+      exit(1);
+   }
+   m = atoi(argv[optind]);
+   n = atoi(argv[optind+1]);
+   dir = (argc - optind > 2) ? argv[optind+2] : "input";
+   if ((mkdir(dir, 0755) < 0) && (errno != EEXIST)) {
+      perror(dir);
       exit(1);
    }
-   m = atoi(argv[1]);
-   n = atoi(argv[2]);
 
-   srand((unsigned int)time(NULL));
+   srand(seed);
 
    TOTAL = (int *)malloc(m * sizeof(int));
    for (j=0; j<m; ++j) TOTAL[j] = 15 + rand() % 16;
-   fp = (FILE *)fopen("input/system.txt", "w");
-   fprintf(fp, "%d\n%d\n", m, n);
-   for (j=0; j<m; ++j) fprintf(fp, "%d%c", TOTAL[j],  (j == m-1) ? '\n' : ' ');
-   fclose(fp);
+   sprintf(fname, "%.4000s/%s", dir, SCN_FILE);
+   if (bin) {
+      MAXALL = (int32_t *)malloc((size_t)n * m * sizeof(int32_t));
+      start = (int64_t *)malloc((n + 1) * sizeof(int64_t));
+   } else {
+      unlink(fname);   /* resource prefers scenario.bin over the text files */
+      sprintf(fname, "%.4000s/system.txt", dir);
+      fp = (FILE *)fopen(fname, "w");
+      fprintf(fp, "%d\n%d\n", m, n);
+      for (j=0; j<m; ++j) fprintf(fp, "%d%c", TOTAL[j],  (j == m-1) ? '\n' : ' ');
+      fclose(fp);
+   }
 
    MAX = (int *)malloc(m * sizeof(int));
    ALLOC = (int *)malloc(m * sizeof(int));
    for (i=0; i<n; ++i) {
-      sprintf(fname, "input/thread%02d.txt", i);
-      fp = (FILE *)fopen(fname,"w");
+      if (!bin) {
+         sprintf(fname, "%.4000s/thread%02d.txt", dir, i);
+         fp = (FILE *)fopen(fname,"w");
+      }
       nr = 5 + rand() % 6;
-      fprintf(fp, "      ");
+      if (!bin) fprintf(fp, "      ");
       for (j=0; j<m; ++j) {
          /* Use one of the following two lines */
          MAX[j] = rand() % (TOTAL[j] / 2);  /* Likely to create deadlock */
          // MAX[j] = rand() % (TOTAL[j] / 3);  /* Likely to create unsafe states without deadlock */
          ALLOC[j] = 0;
-         fprintf(fp, "%3d%c", MAX[j], (j == m-1) ? '\n' : ' ');
+         if (bin) MAXALL[(size_t)i * m + j] = MAX[j];
+         else fprintf(fp, "%3d%c", MAX[j], (j == m-1) ? '\n' : ' ');
       }
+      if (bin) start[i] = nops;
       for (k=0; k<nr; ++k) {
-         fprintf(fp, "%2d  R", 5 + rand() % 36);
+         delay = 5 + rand() % 36;
+         op = bin ? newop(delay, SCN_REQUEST) : NULL;
+         if (!bin) fprintf(fp, "%2d  R", delay);
          for (j=0; j<m; ++j) {
             if (ALLOC[j] == 0) rt = 1;
             else if (ALLOC[j] == MAX[j]) rt = 0;
             else rt = rand() % 2;
             if (rt == 0) req = -(rand() % (1 + ALLOC[j]));
             else req = rand() % (1 + MAX[j] - ALLOC[j]);
-            fprintf(fp, " %3d", req);
+            if (bin) op[2+j] = req;
+            else fprintf(fp, " %3d", req);
             ALLOC[j] += req;
          }
-         fprintf(fp, "\n");
+         if (!bin) fprintf(fp, "\n");
       }
-      fprintf(fp, "%2d  Q\n", 5 + rand() % 36);
-      fclose(fp);
+      delay = 5 + rand() % 36;
+      if (bin) newop(delay, SCN_QUIT);
+      else {
+         fprintf(fp, "%2d  Q\n", delay);
+         fclose(fp);
+      }
+   }
+
+   if (bin) {
+      start[n] = nops;
+      memcpy(hdr.magic, SCN_MAGIC, sizeof(hdr.magic));
+      hdr.m = m;
+      hdr.n = n;
+      sprintf(fname, "%.4000s/%s", dir, SCN_FILE);
+      fp = (FILE *)fopen(fname, "wb");
+      if (fp == NULL) { perror(fname); exit(1); }
+      fwrite(&hdr, sizeof(hdr), 1, fp);
+      fwrite(start, sizeof(int64_t), n + 1, fp);
+      for (j=0; j<m; ++j) fwrite(&TOTAL[j], sizeof(int32_t), 1, fp);
+      fwrite(MAXALL, sizeof(int32_t), (size_t)n * m, fp);
+      fwrite(OPS, sizeof(int32_t) * SCN_OP_INTS(m), nops, fp);
+      if (fclose(fp) != 0) { perror(fname); exit(1); }
    }
 
    exit(0);
@@ -0,0 +1,90 @@
+#ifndef PARK_H_
+#define PARK_H_
+
+// Parking spot for a thread that waits for one completion at a time.
+// The whole handshake is one atomic word: 0 while the request is in flight,
+// 1 once the waker has completed it, 2 while the waiter is asleep. The waker
+// publishes with a single exchange and enters the kernel only if the waiter
+// actually went to sleep; the waiter spins briefly before it sleeps. On Linux
+// the word is a futex; elsewhere a mutex and condition variable stand in.
+
+#include <atomic>
+#include <sched.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <pthread.h>
+#endif
+
+#define PARK_SPIN 100 // polls of the word before going to sleep
+
+typedef struct {
+    std::atomic<int> state; // 0 waiting, 1 done, 2 asleep
+#ifndef __linux__
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+#endif
+} Park;
+
+static inline void park_init(Park *p){
+    p->state.store(0);
+#ifndef __linux__
+    pthread_mutex_init(&p->mtx, NULL);
+    pthread_cond_init(&p->cv, NULL);
+#endif
+}
+
+static inline void park_destroy(Park *p){
+#ifndef __linux__
+    pthread_mutex_destroy(&p->mtx);
+    pthread_cond_destroy(&p->cv);
+#else
+    (void)p;
+#endif
+}
+
+// Waiter: block until park_wake(), then rearm for the next request
+static inline void park_wait(Park *p){
+    for(int i = 0; i < PARK_SPIN; i++){
+        if(p->state.load(std::memory_order_acquire) == 1){
+            p->state.store(0, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    int expected = 0;
+#ifdef __linux__
+    if(p->state.compare_exchange_strong(expected, 2)){
+        while(p->state.load() == 2){
+            syscall(SYS_futex, (int *)&p->state, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+        }
+    }
+#else
+    pthread_mutex_lock(&p->mtx);
+    if(p->state.compare_exchange_strong(expected, 2)){
+        while(p->state.load() == 2){
+            pthread_cond_wait(&p->cv, &p->mtx);
+        }
+    }
+    pthread_mutex_unlock(&p->mtx);
+#endif
+    p->state.store(0, std::memory_order_relaxed);
+}
+
+// Waker: complete the request; a system call only if the waiter sleeps
+static inline void park_wake(Park *p){
+    if(p->state.exchange(1) == 2){
+#ifdef __linux__
+        syscall(SYS_futex, (int *)&p->state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+        pthread_mutex_lock(&p->mtx);
+        pthread_cond_signal(&p->cv);
+        pthread_mutex_unlock(&p->mtx);
+#endif
+    }
+}
+
+#endif
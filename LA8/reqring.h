@@ -0,0 +1,139 @@
+#ifndef REQRING_H_
+#define REQRING_H_
+
+// Bounded multi-producer/single-consumer ring of preallocated request slots.
+// Producers claim a ticket with one CAS on the tail and publish the slot by
+// bumping its sequence number; the single consumer drains slots in ticket
+// order without taking any lock. The consumer sleeps on a condition variable
+// only when the ring is empty, and producers signal it only if it does.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <atomic>
+
+typedef struct {
+    int type; // 0 for RELEASE, 1 for ADDITIONAL, 2 for QUIT (resource.cpp adds 3, 4)
+    int thread_id;
+    int *request;
+} Request;
+
+// Slot for ticket t is free when seq == t and holds a published request when
+// seq == t + 1; the consumer advances seq by the ring size to recycle it.
+typedef struct {
+    std::atomic<unsigned> seq;
+    Request req; // req.request points to m ints of the ring's arena
+} Slot;
+
+typedef struct {
+    Slot *slots;
+    int *arena;
+    unsigned mask;
+    int m;
+    std::atomic<unsigned> tail; // next ticket handed to a producer
+    unsigned head;              // next ticket the consumer takes
+    std::atomic<bool> sleeping;
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+} ReqRing;
+
+// Ring with room for at least min_slots requests of m resource types
+static inline void ring_init(ReqRing *r, unsigned min_slots, int m){
+    unsigned size = 1;
+    while (size < min_slots) size <<= 1;
+    r->slots = new Slot[size];
+    r->arena = (int *)calloc((size_t)size * m, sizeof(int));
+    r->mask = size - 1;
+    r->m = m;
+    r->tail.store(0);
+    r->head = 0;
+    r->sleeping.store(false);
+    pthread_mutex_init(&r->mtx, NULL);
+    pthread_cond_init(&r->cv, NULL);
+    for (unsigned i = 0; i < size; i++) {
+        r->slots[i].seq.store(i);
+        r->slots[i].req.request = r->arena + (size_t)i * m;
+    }
+}
+
+static inline void ring_destroy(ReqRing *r){
+    delete[] r->slots;
+    free(r->arena);
+    pthread_mutex_destroy(&r->mtx);
+    pthread_cond_destroy(&r->cv);
+}
+
+// Publish a request (the first len entries of request, the rest zero).
+// Spins with sched_yield() only if the ring is full.
+static inline void ring_push(ReqRing *r, int type, int tid, const int *request, int len){
+    unsigned pos = r->tail.load(std::memory_order_relaxed);
+    Slot *slot;
+    while(1){
+        slot = &r->slots[pos & r->mask];
+        int dif = (int)(slot->seq.load(std::memory_order_acquire) - pos);
+        if(dif == 0){
+            if(r->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if(dif < 0){ // full
+            sched_yield();
+            pos = r->tail.load(std::memory_order_relaxed);
+        }
+        else{
+            pos = r->tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->req.type = type;
+    slot->req.thread_id = tid;
+    for(int i = 0; i < r->m; i++){
+        slot->req.request[i] = (i < len) ? request[i] : 0;
+    }
+    // seq_cst store: pairs with the consumer's store to sleeping (Dekker style)
+    slot->seq.store(pos + 1);
+
+    // wake the consumer if it went to sleep on an empty ring
+    if(r->sleeping.load()){
+        pthread_mutex_lock(&r->mtx);
+        pthread_cond_signal(&r->cv);
+        pthread_mutex_unlock(&r->mtx);
+    }
+}
+
+static inline bool ring_empty(ReqRing *r){
+    return r->slots[r->head & r->mask].seq.load(std::memory_order_acquire) != r->head + 1;
+}
+
+// Take the next published request, copying its vector into request
+static inline bool ring_pop(ReqRing *r, Request *out, int *request){
+    Slot *slot = &r->slots[r->head & r->mask];
+    if(slot->seq.load(std::memory_order_acquire) != r->head + 1){
+        return false;
+    }
+    out->type = slot->req.type;
+    out->thread_id = slot->req.thread_id;
+    out->request = request;
+    for(int i = 0; i < r->m; i++){
+        request[i] = slot->req.request[i];
+    }
+    slot->seq.store(r->head + r->mask + 1, std::memory_order_release);
+    r->head++;
+    return true;
+}
+
+// Consumer: block until at least one request is published.
+// Returns whether it had to sleep.
+static inline bool ring_wait(ReqRing *r){
+    if(!ring_empty(r)) return false;
+    bool slept = false;
+    pthread_mutex_lock(&r->mtx);
+    r->sleeping.store(true);
+    while(r->slots[r->head & r->mask].seq.load() != r->head + 1){
+        pthread_cond_wait(&r->cv, &r->mtx);
+        slept = true;
+    }
+    r->sleeping.store(false);
+    pthread_mutex_unlock(&r->mtx);
+    return slept;
+}
+
+#endif
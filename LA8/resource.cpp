@@ -4,248 +4,358 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
-#include <queue>
+#include <limits.h>
+#include <time.h>
+#include <stdarg.h>
+#include <getopt.h>
 #include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "reqring.h"
+#include "park.h"
+#include "scenario.h"
+#include "trace.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #ifdef __APPLE__
 #include "pthread_barrier.h"
 #endif
 
-// Maximum values
-#define MAX_RESOURCES 20
-#define MAX_THREADS 100
+// Microseconds per unit of delay in the thread files
+#ifndef DELAY_UNIT
+#define DELAY_UNIT 50000
+#endif
+
+// Stack size of a user thread; small, so that thousands of threads fit
+#define USER_STACK (256 * 1024)
+
+// Matrix rows are padded to a multiple of ROW_ALIGN ints (64 bytes) and start
+// on a 64-byte boundary; the padding stays zero
+#define ROW_ALIGN 16
+
+// Events kept per user thread and per master with -t (powers of two)
+#define TRACE_USER_EVENTS 256
+#define TRACE_MASTER_EVENTS (1 << 16)
 
 // sync variables
-pthread_mutex_t rmtx; // Resource mutex
 pthread_mutex_t pmtx; // Print mutex
 pthread_barrier_t BOS; // Beginning of session barrier
-pthread_barrier_t REQB; // Request barrier
+
+// Shards (-S k): the resource types are split into k contiguous ranges, each
+// managed by its own master thread with its own request ring. A request goes to
+// the shard of its first nonzero resource (QUIT to shard 0), which locks every
+// shard the request touches in ascending order, checks and commits the change
+// under those locks, and unlocks (a two-phase reservation). With _DLAVOID the
+// safety check reads every column, so a grant locks all shards. A release that
+// may unblock a request of another shard sends that shard a RECHECK.
+typedef struct {
+    int id, lo, hi; // resource types lo..hi-1
+    ReqRing ring; // requests from the user threads and kicks from other shards
+    pthread_mutex_t mtx; // guards columns lo..hi-1 of ALLOC, NEED, AVAILABLE and blocked_on
+    std::vector<int> cand, unsafe_wait; // this shard's part of the pending index
+    std::vector<std::pair<std::pair<double, long>, int> > order; // scratch of process_pending_requests
+    std::vector<int> granted;
+    bool *owns; // owns[t]: thread t's pending request is held here
+    bool *locked; // shards this manager holds locked
+    bool blocked_now; // some pending request failed in the last pass
+    std::atomic<bool> recheck_unsafe; // a RECHECK of unsafe_wait is queued
+    TraceBuf trace; // events recorded by this master (-t)
+    pthread_t tid;
+} Shard;
+
+Shard *shards;
+int nshards = 1;
+int *shard_of; // shard of each resource type
+thread_local Shard *self; // shard of the calling master thread
 
 // Thread-specific synchronization
-pthread_barrier_t *ACKB; // Acknowledgment barriers for each thread
-pthread_cond_t *cv; // Condition variables for each thread
-pthread_mutex_t *cmtx; // Mutex for condition variables
+Park *parks; // Completed by the master when the thread's last request is done
 
 // threads function prototypes
 void *user_thread(void *arg);
 
-// Global request variable
+int m, n; // Number of resource types, Number of threads
+
+// The scenario: system.txt and the thread files, either mapped from
+// scenario.bin or imported from the text files by parallel loader threads
 typedef struct {
-    int type; // 0 for RELEASE, 1 for ADDITIONAL, 2 for QUIT
-    int thread_id;
-    int *request;
-} Request;
+    const int *avail; // m
+    const int *max; // n x m
+    const int **ops; // per thread, nops[t] ops of SCN_OP_INTS(m) ints
+    int *nops;
+    void *map; // mapping of scenario.bin, NULL after a text import
+    size_t map_len;
+    int *text_avail, *text_max; // buffers of a text import
+    std::vector<int> *text_ops;
+} scenario_t;
+
+scenario_t scn;
+std::atomic<bool> load_failed(false);
+int **ALLOC, **MAX_NEED, **NEED;
+int *AVAILABLE; // Available resources
+bool *active_threads;
+int terminated_threads = 0;
+const char *input_dir = "input";
+bool show_stats = false; // -s: report grant latency and safety check counts
+bool quiet = false; // -q: no simulation log on the console
+const char *trace_file = NULL; // -t: dump the event trace here at exit
+LatHist *grant_hist; // per thread, latency of its ADDITIONAL requests in ns
+TraceBuf *utrace; // events recorded by each user thread (-t)
+long fast_checks = 0, resumed_checks = 0, full_checks = 0;
+
+// Deadlock detection (-D) and recovery by aborting a victim (-r)
+enum { VICTIM_NONE, VICTIM_MINALLOC, VICTIM_MAXALLOC, VICTIM_LATEST };
+const char *victim_names[] = { "none", "minalloc", "maxalloc", "latest" };
+bool detect = false;
+int victim_policy = VICTIM_NONE;
+bool *aborted; // set by the master before it wakes an aborted thread
+bool *deadlocked; // deadlocked set last reported
 
 typedef struct{
     int thread_id;
     int *req;
 } local_request;
 
-Request *g_request;
+// Order in which pending requests are tried (-p)
+enum { POLICY_FIFO, POLICY_SMALL, POLICY_AGING, POLICY_FAIR };
+const char *policy_names[] = { "fifo", "small", "aging", "fair" };
+int policy = POLICY_FIFO;
+
+// Pending ADDITIONAL requests; a thread has at most one
+typedef struct {
+    int *req; // NULL if the thread has none pending
+    long seq; // arrival order
+    double since; // arrival time in ms
+    int size; // total instances asked for
+    int home; // shard holding the request
+} pending_t;
+
+pending_t *pending;
+std::atomic<long> arrivals(0);
+
+// Index of the pending set: each pending request is in exactly one of
+//   cand          to be tried at the end of the current batch (per shard)
+//   blocked_on[j] asks for more of resource j than is available
+//   unsafe_wait   fits, but granting it now is unsafe (per shard)
+// A grant only lowers AVAILABLE, so a request that failed stays ungrantable
+// until a release: a release of resource j moves blocked_on[j] (and any
+// release moves unsafe_wait) back to cand.
+std::vector<int> *blocked_on;
+
+// Banker's scratch state, allocated once in main() so that no safety check allocates.
+// safe_seq is the last safe sequence found; slack row k holds, per resource, the
+// least surplus (work - NEED) of the threads before position k of that sequence.
+int *safe_seq, *cand_seq;
+int *pending_seq; // threads a resumed check has yet to place
+int safe_len = 0;
+int *seq_pos; // position of each thread in safe_seq, -1 if absent
+int *slack; // (n + 1) x stride
+std::atomic<bool> safe_dirty(true); // ALLOC/NEED/AVAILABLE changed since slack was computed
+int *work;
+bool *finish;
+int stride; // m rounded up to ROW_ALIGN
 
 // function prototypes
-void process_pending_requests(std::queue<local_request> &Q, int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads);
-bool can_fulfill_req(local_request lr, int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads);
-bool is_safe_state(int m, int n, int ** ALLOC, int ** NEED, int * AVAILABLE, bool * active_threads);
-void printQ(std::queue<local_request> &Q);
+void process_pending_requests(int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads);
+bool can_fulfill_req(local_request lr, int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads, int *blocking);
+void wake_blocked(int j);
+void *manager(void *arg);
+void lock_shards(const int *req);
+void unlock_shards();
+int detect_deadlock(int m, int n, int **ALLOC, int *AVAILABLE, bool *active_threads, bool *dl);
+int recover_deadlock(int m, int n, int **ALLOC, int **NEED, int **MAX_NEED, int *AVAILABLE, bool *active_threads);
+bool is_safe_state(int m, int n, int ** ALLOC, int ** NEED, int * AVAILABLE, bool * active_threads, int *seq, int *len);
+bool request_is_safe(int thread_id, int *request, int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads);
+int *alloc_rows(int rows);
+int **alloc_matrix(int rows);
+void free_matrix(int **M);
+char *read_file(const char *path);
+int load_binary(const char *path);
+bool load_text();
+void free_scenario();
+double now_ms();
+void say(const char *fmt, ...);
+void print_stats();
+bool dump_trace(const char *path);
+void printQ();
+
+// Request types on the rings (see reqring.h for 0..2)
+#define REQ_RECHECK 3 // retry thread_id's request, or unsafe_wait if thread_id < 0
+#define REQ_STOP 4 // all threads have quit
+
+// Block the user thread until the master completes its request
+void wait_for_master(int tid){
+    park_wait(&parks[tid]);
+}
 
+// One atomic exchange; a futex wake only if the thread is asleep
+void notify_thread(int tid){
+    park_wake(&parks[tid]);
+}
 
-int main(){
-    /***** Read system configuration *****/
-    FILE *system_file = fopen("input/system.txt", "r");
-    if (!system_file) {
-        perror("Error opening system.txt");
+
+int main(int argc, char *argv[]){
+    static const struct option longopts[] = {
+        { "quiet", no_argument, NULL, 'q' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while((opt = getopt_long(argc, argv, "i:p:sDr:S:qt:", longopts, NULL)) != -1){
+        switch(opt){
+            case 'i': input_dir = optarg; break;
+            case 'p':
+                policy = -1;
+                for(int k = 0; k < 4; k++){
+                    if(strcmp(optarg, policy_names[k]) == 0) policy = k;
+                }
+                if(policy < 0){
+                    fprintf(stderr, "Unknown grant policy %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 's': show_stats = true; break;
+            case 'D': detect = true; break;
+            case 'r':
+                victim_policy = VICTIM_NONE;
+                for(int k = 1; k < 4; k++){
+                    if(strcmp(optarg, victim_names[k]) == 0) victim_policy = k;
+                }
+                if(victim_policy == VICTIM_NONE){
+                    fprintf(stderr, "Unknown victim policy %s\n", optarg);
+                    return 1;
+                }
+                detect = true;
+                break;
+            case 'S': nshards = atoi(optarg); break;
+            case 'q': quiet = true; break;
+            case 't': trace_file = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-i input_dir] [-p fifo|small|aging|fair] [-s] [-D] [-r minalloc|maxalloc|latest] [-S shards] [-q|--quiet] [-t trace_file]\n", argv[0]);
+                return 1;
+        }
+    }
+    if(nshards < 1) nshards = 1;
+    if(detect && nshards > 1){
+        fprintf(stderr, "Deadlock detection needs a single master (-S 1)\n");
         return 1;
     }
 
-    int m, n; // Number of resource types, Number of threads
-    fscanf(system_file, "%d %d", &m, &n);
-    if(m > MAX_RESOURCES || n > MAX_THREADS){
-        perror("Number of resource types or threads exceeds maximum");
+    /***** Read the scenario: scenario.bin if present, else the text files *****/
+    char filename[PATH_MAX];
+    snprintf(filename, sizeof(filename), "%s/%s", input_dir, SCN_FILE);
+    int loaded = load_binary(filename);
+    if (loaded < 0 || (loaded == 0 && !load_text())) {
         return 1;
     }
 
-    int AVAILABLE[m]; // Available resources
-    for (int i = 0; i < m; i++) {
-        fscanf(system_file, "%d", &AVAILABLE[i]);
-    }
-    fclose(system_file);
+    AVAILABLE = (int *)malloc(m * sizeof(int));
+    memcpy(AVAILABLE, scn.avail, m * sizeof(int));
 
-    // Initialize matrices
-    int ** ALLOC = (int **)malloc(n * sizeof(int *));
-    int ** MAX_NEED = (int **)malloc(n * sizeof(int *));
-    int ** NEED = (int **)malloc(n * sizeof(int *));
-    for (int i = 0; i < n; i++) {
-        ALLOC[i] = (int *)malloc(m * sizeof(int));
-        MAX_NEED[i] = (int *)malloc(m * sizeof(int));
-        NEED[i] = (int *)malloc(m * sizeof(int));
-    }
-    // Initialize ALLOC matrix to zero
-    for (int i = 0; i < n; i++) {
-        memset(ALLOC[i], 0, m * sizeof(int));
-    }
+    // Initialize matrices, each one contiguous block (ALLOC starts out zero)
+    stride = (m + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN;
+    ALLOC = alloc_matrix(n);
+    MAX_NEED = alloc_matrix(n);
+    NEED = alloc_matrix(n);
 
-    // Read thread files to initialize MAX_NEED and NEED matrices
+    // Initialize MAX_NEED and NEED matrices
     for (int i = 0; i < n; i++) {
-        char filename[30];
-        sprintf(filename, "input/thread%02d.txt", i);
-        FILE *thread_file = fopen(filename, "r");
-        if (!thread_file) {
-            perror("Error opening thread file");
-            return 1;
-        }
-
         for (int j = 0; j < m; j++) {
-            fscanf(thread_file, "%d", &MAX_NEED[i][j]);
+            MAX_NEED[i][j] = scn.max[(size_t)i * m + j];
             NEED[i][j] = MAX_NEED[i][j]; // Initially, need = max need
         }
-        fclose(thread_file);
     }
 
     /***** Initialize synchronization primitives *****/
-    pthread_mutex_init(&rmtx, NULL);
     pthread_mutex_init(&pmtx, NULL);
     pthread_barrier_init(&BOS, NULL, n + 1);
-    pthread_barrier_init(&REQB, NULL, 2);
+
+    // Safety check scratch; start from the sequence 0, 1, ..., n-1
+    safe_seq = (int *)malloc(n * sizeof(int));
+    cand_seq = (int *)malloc(n * sizeof(int));
+    pending_seq = (int *)malloc(n * sizeof(int));
+    seq_pos = (int *)malloc(n * sizeof(int));
+    slack = alloc_rows(n + 1);
+    work = alloc_rows(1);
+    finish = (bool *)malloc(n * sizeof(bool));
+    for (int i = 0; i < n; i++) safe_seq[i] = i;
+    safe_len = n;
+
+    // Shards. A ring holds at most one request per thread, one RECHECK per
+    // pending thread, one RECHECK of unsafe_wait and the STOP: it never fills up.
+    if(nshards > m) nshards = m;
+    shards = new Shard[nshards];
+    shard_of = (int *)malloc(m * sizeof(int));
+    for (int s = 0; s < nshards; s++) {
+        Shard *sh = &shards[s];
+        sh->id = s;
+        sh->lo = (int)((long)m * s / nshards);
+        sh->hi = (int)((long)m * (s + 1) / nshards);
+        for (int j = sh->lo; j < sh->hi; j++) shard_of[j] = s;
+        ring_init(&sh->ring, 2 * n + 2, m);
+        pthread_mutex_init(&sh->mtx, NULL);
+        sh->owns = (bool *)calloc(n, sizeof(bool));
+        sh->locked = (bool *)calloc(nshards, sizeof(bool));
+        sh->blocked_now = false;
+        sh->recheck_unsafe.store(false);
+        trace_init(&sh->trace, trace_file ? TRACE_MASTER_EVENTS : 0);
+    }
 
     // Initialize thread-specific synchronization
-    ACKB = (pthread_barrier_t *)malloc(n * sizeof(pthread_barrier_t));
-    cv = (pthread_cond_t *)malloc(n * sizeof(pthread_cond_t));
-    cmtx = (pthread_mutex_t *)malloc(n * sizeof(pthread_mutex_t));
+    parks = new Park[n];
+    grant_hist = (LatHist *)calloc(n, sizeof(LatHist));
+    utrace = (TraceBuf *)malloc(n * sizeof(TraceBuf));
+    pending = (pending_t *)calloc(n, sizeof(pending_t));
+    blocked_on = new std::vector<int>[m];
+    aborted = (bool *)calloc(n, sizeof(bool));
+    deadlocked = (bool *)calloc(n, sizeof(bool));
 
     for (int i = 0; i < n; i++) {
-        pthread_barrier_init(&ACKB[i], NULL, 2);
-        pthread_cond_init(&cv[i], NULL);
-        pthread_mutex_init(&cmtx[i], NULL);
+        park_init(&parks[i]);
+        trace_init(&utrace[i], trace_file ? TRACE_USER_EVENTS : 0);
+    }
+    trace_epoch = clock_ns();
+
+    active_threads = (bool *)malloc(n * sizeof(bool));
+    for(int i = 0; i < n; i++){
+        active_threads[i] = 1;
     }
 
     // Create user threads
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, USER_STACK);
     pthread_t *users = (pthread_t *)malloc(n * sizeof(pthread_t));
     for (int i = 0; i < n; i++) {
         int *id = (int *)malloc(sizeof(int));
         *id = i;
-        pthread_create(&users[i], NULL, user_thread, id);
+        if (pthread_create(&users[i], &attr, user_thread, id) != 0) {
+            perror("Error creating user thread");
+            return 1;
+        }
     }
+    pthread_attr_destroy(&attr);
 
     /************************ master work ************************/
 
-    // local master request queue
-    std::queue<local_request> Q;
+    // Managers of shards 1..k-1 run in their own threads, shard 0 in this one
+    for (int s = 1; s < nshards; s++) {
+        pthread_create(&shards[s].tid, NULL, manager, &shards[s]);
+    }
 
     // Wait for all threads to be ready
     pthread_barrier_wait(&BOS);
 
-    int terminated_threads = 0;
-    bool active_threads[n];
-    for(int i = 0; i < n; i++){
-        active_threads[i] = 1;
-    }
-
-    /****** Main processing loop ******/
-    while(1){
-        // wait for a req
-        pthread_barrier_wait(&REQB);
+    manager(&shards[0]);
 
-        // process req
-        int thread_id = g_request->thread_id;
-        int request_type = g_request->type;
-        int *request;
-        if(request_type != 2){ // QUIT
-            request = (int *)malloc(MAX_RESOURCES * sizeof(int));
-            for(int i = 0; i < m; i++){
-                request[i] = g_request->request[i];
-            }
-            // free g_request
-            if(g_request->request){
-                free(g_request->request);
-            }
-            free(g_request);
-
-            // Acknowledge receipt of request
-            pthread_barrier_wait(&ACKB[thread_id]);
-        }
-        
-
-
-        if(request_type == 2){ // QUIT
-            // release all resources held by the thread
-            for (int i = 0; i < m; i++) {
-                AVAILABLE[i] += ALLOC[thread_id][i];
-                ALLOC[thread_id][i] = 0;
-                NEED[thread_id][i] = MAX_NEED[thread_id][i];
-            }
-
-            terminated_threads++;
-            active_threads[thread_id] = 0;
-
-            pthread_mutex_lock(&pmtx);
-            printf("Master thread releases resources of thread %d\n", thread_id);
-            fflush(stdout);
-
-            // print waiting threads
-            printQ(Q);
-            
-            // print active threads
-            printf("%d threads left: ", n - terminated_threads);
-            for(int i = 0; i < n; i++){
-                if(active_threads[i]){
-                    printf("%d ", i);
-                }
-            }
-            printf("\n");
-            fflush(stdout);
-            
-            // print available resources
-            printf("Available resources: ");
-            for(int i = 0; i < m; i++){
-                printf("%d ", AVAILABLE[i]);
-            }
-            printf("\n");
-            fflush(stdout);
-            pthread_mutex_unlock(&pmtx);
-
-            // send ack
-            pthread_barrier_wait(&ACKB[thread_id]);
-
-        }
-        else if(request_type == 1){ // ADDITIONAL
-            // handle release components first
-            for (int i = 0; i < m; i++) {
-                if(request[i] < 0){
-                    AVAILABLE[i] += -request[i];
-                    ALLOC[thread_id][i] += request[i];
-                    NEED[thread_id][i] -= request[i];
-                    request[i] = 0;
-                }
-            }
-            
-            // enqueue the request
-            local_request lr;
-            lr.thread_id = thread_id;
-            lr.req = request;
-            Q.push(lr);
-
-            pthread_mutex_lock(&pmtx);
-            printf("Master thread stores resource request of thread %d\n", thread_id);
-            fflush(stdout);
-            pthread_mutex_unlock(&pmtx);
-        }
-        else{ // RELEASE
-            for (int i = 0; i < m; i++) {
-                if(request[i] < 0){
-                    AVAILABLE[i] += -request[i];
-                    ALLOC[thread_id][i] += request[i];
-                    NEED[thread_id][i] -= request[i];
-                }
-            }
-        }
-
-        if(terminated_threads == n){
-            break;
-        }
-
-        // process pending requests
-        process_pending_requests(Q, m, n, ALLOC, NEED, AVAILABLE, active_threads);
+    for (int s = 1; s < nshards; s++) {
+        ring_push(&shards[s].ring, REQ_STOP, -1, NULL, 0);
+        pthread_join(shards[s].tid, NULL);
     }
 
     /********************** master work end **********************/
@@ -256,276 +366,959 @@ int main(){
         
     }
 
-    pthread_mutex_lock(&pmtx);
-    printf("==> Master: All threads terminated, simulation ending\n");
-    fflush(stdout);
-    pthread_mutex_unlock(&pmtx);
+    say("==> Master: All threads terminated, simulation ending\n");
 
+    if(show_stats){
+        print_stats();
+    }
+    if(trace_file && !dump_trace(trace_file)){
+        perror(trace_file);
+    }
 
     // Cleanup
-    pthread_mutex_destroy(&rmtx);
     pthread_mutex_destroy(&pmtx);
     pthread_barrier_destroy(&BOS);
-    pthread_barrier_destroy(&REQB);
 
     for (int i = 0; i < n; i++) {
-        pthread_barrier_destroy(&ACKB[i]);
-        pthread_cond_destroy(&cv[i]);
-        pthread_mutex_destroy(&cmtx[i]);
+        park_destroy(&parks[i]);
+        trace_free(&utrace[i]);
     }
 
     free(users);
-    free(ACKB);
-    free(cv);
-    free(cmtx);
+    delete[] parks;
+    free(grant_hist);
+    free(utrace);
+    free(pending);
+    delete[] blocked_on;
+    free(aborted);
+    free(deadlocked);
+    for (int s = 0; s < nshards; s++) {
+        ring_destroy(&shards[s].ring);
+        pthread_mutex_destroy(&shards[s].mtx);
+        free(shards[s].owns);
+        free(shards[s].locked);
+        trace_free(&shards[s].trace);
+    }
+    delete[] shards;
+    free(shard_of);
+    free(safe_seq);
+    free(cand_seq);
+    free(pending_seq);
+    free(seq_pos);
+    free(slack);
+    free(work);
+    free(finish);
+    free_matrix(ALLOC);
+    free_matrix(MAX_NEED);
+    free_matrix(NEED);
+    free(AVAILABLE);
+    free(active_threads);
+    free_scenario();
 
     return 0;    
 }
 
-void *user_thread(void *arg){
-    int tid = *(int *)arg;  
-    free(arg);
+// Master thread of one shard: drains its ring, applies releases, and tries
+// its pending requests once per batch. Shard 0 also handles QUIT and ends
+// the simulation.
+void *manager(void *arg){
+    Shard *sh = (Shard *)arg;
+    self = sh;
+
+    Request req;
+    bool finished = false;
+    while(!finished){
+        // sleep until the ring has a request
+        ring_wait(&sh->ring);
+
+        // drain everything published so far, then try the pending requests once
+        int *request = (int *)malloc(m * sizeof(int));
+        while(ring_pop(&sh->ring, &req, request)){
+            int thread_id = req.thread_id;
+            int request_type = req.type;
+
+            if(request_type == 2){ // QUIT (always sent to shard 0)
+                lock_shards(NULL);
+
+                // release all resources held by the thread
+                for (int i = 0; i < m; i++) {
+                    if (ALLOC[thread_id][i] > 0) wake_blocked(i);
+                    AVAILABLE[i] += ALLOC[thread_id][i];
+                    ALLOC[thread_id][i] = 0;
+                    NEED[thread_id][i] = MAX_NEED[thread_id][i];
+                }
 
-    // open thread file
-    char filename[30];
-    sprintf(filename, "input/thread%02d.txt", tid);
-    FILE *thread_file = fopen(filename, "r");
+                terminated_threads++;
+                active_threads[thread_id] = 0;
+                safe_dirty = true;
+                trace_record(&sh->trace, TR_QUIT, thread_id, 0);
+
+                if(!quiet){
+                    pthread_mutex_lock(&pmtx);
+                    printf("Master thread releases resources of thread %d\n", thread_id);
+                    fflush(stdout);
+
+                    // print waiting threads
+                    printQ();
+
+                    // print active threads
+                    printf("%d threads left: ", n - terminated_threads);
+                    for(int i = 0; i < n; i++){
+                        if(active_threads[i]){
+                            printf("%d ", i);
+                        }
+                    }
+                    printf("\n");
+                    fflush(stdout);
 
-    if(!thread_file){
-        perror("Error opening thread file");
-        return NULL;
-    }
+                    // print available resources
+                    printf("Available resources: ");
+                    for(int i = 0; i < m; i++){
+                        printf("%d ", AVAILABLE[i]);
+                    }
+                    printf("\n");
+                    fflush(stdout);
+                    pthread_mutex_unlock(&pmtx);
+                }
+                unlock_shards();
 
-    // Wait for all threads to be ready
-    pthread_barrier_wait(&BOS);
+                // send ack
+                notify_thread(thread_id);
+            }
+            else if(request_type == 1){ // ADDITIONAL
+                // handle release components first
+                lock_shards(request);
+                for (int i = 0; i < m; i++) {
+                    if(request[i] < 0){
+                        AVAILABLE[i] += -request[i];
+                        ALLOC[thread_id][i] += request[i];
+                        NEED[thread_id][i] -= request[i];
+                        request[i] = 0;
+                        safe_dirty = true;
+                        wake_blocked(i);
+                    }
+                }
+                unlock_shards();
+                
+                // add the request to the pending set; the thread is notified when it is granted
+                pending_t *p = &pending[thread_id];
+                p->req = request;
+                p->seq = arrivals++;
+                p->since = now_ms();
+                p->size = 0;
+                for (int i = 0; i < m; i++) p->size += request[i];
+                p->home = sh->id;
+                sh->owns[thread_id] = true;
+                sh->cand.push_back(thread_id);
+                request = (int *)malloc(m * sizeof(int));
+                trace_record(&sh->trace, TR_STORE, thread_id, 0);
+
+                say("Master thread stores resource request of thread %d\n", thread_id);
+            }
+            else if(request_type == 0){ // RELEASE
+                lock_shards(request);
+                for (int i = 0; i < m; i++) {
+                    if(request[i] < 0){
+                        AVAILABLE[i] += -request[i];
+                        ALLOC[thread_id][i] += request[i];
+                        NEED[thread_id][i] -= request[i];
+                        safe_dirty = true;
+                        wake_blocked(i);
+                    }
+                }
+                unlock_shards();
+                trace_record(&sh->trace, TR_RELEASE, thread_id, 0);
 
-    // Skip the max needs line - already read in main
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read;
-    
-    if ((read = getline(&line, &len, thread_file)) == -1) {
-        perror("Error reading from thread file");
-        free(line);
-        fclose(thread_file);
-        return NULL;
+                // send ack
+                notify_thread(thread_id);
+            }
+            else if(request_type == REQ_RECHECK){ // another shard released resources
+                if(thread_id < 0){
+                    sh->recheck_unsafe.store(false);
+                    sh->cand.insert(sh->cand.end(), sh->unsafe_wait.begin(), sh->unsafe_wait.end());
+                    sh->unsafe_wait.clear();
+                }
+                else if(sh->owns[thread_id]){
+                    sh->cand.push_back(thread_id);
+                }
+            }
+            else{ // REQ_STOP
+                finished = true;
+            }
+        }
+        free(request);
+
+        if(sh->id == 0){
+            if(terminated_threads < n){
+                // process pending requests
+                process_pending_requests(m, n, ALLOC, NEED, AVAILABLE, active_threads);
+
+                // a request just blocked: look for a deadlock, and break it if asked to
+                if(detect && sh->blocked_now){
+                    terminated_threads += recover_deadlock(m, n, ALLOC, NEED, MAX_NEED, AVAILABLE, active_threads);
+                }
+            }
+            finished = (terminated_threads == n);
+        }
+        else if(!finished){
+            process_pending_requests(m, n, ALLOC, NEED, AVAILABLE, active_threads);
+        }
     }
-    
-    pthread_mutex_lock(&pmtx);
-    printf("    Thread %d born\n", tid);
-    fflush(stdout);
-    pthread_mutex_unlock(&pmtx);
 
-    // Process each request from the thread file
-    while((read = getline(&line, &len, thread_file)) != -1){
-        // Trim newline character
-        if (read > 0 && line[read-1] == '\n') {
-            line[read-1] = '\0';
+    return NULL;
+}
+
+// Lock every shard that req touches (all of them if req is NULL), in ascending order
+void lock_shards(const int *req){
+    for(int s = 0; s < nshards; s++){
+        bool touch = (req == NULL);
+        for(int j = shards[s].lo; j < shards[s].hi && !touch; j++){
+            touch = (req[j] != 0);
         }
-        
-        // Parse request line
-        int delay;
-        char *saveptr; // For thread-safety
-        
-        // Get delay
-        char *token = strtok_r(line, " \t", &saveptr);
-        if(!token) continue;
-        delay = atoi(token);
+        self->locked[s] = touch;
+        if(touch) pthread_mutex_lock(&shards[s].mtx);
+    }
+}
 
-        // Get request type or first resource value
-        token = strtok_r(NULL, " \t", &saveptr);
-        if(!token) continue;
+void unlock_shards(){
+    for(int s = nshards - 1; s >= 0; s--){
+        if(self->locked[s]) pthread_mutex_unlock(&shards[s].mtx);
+        self->locked[s] = false;
+    }
+}
 
-        if(strcmp(token, "Q") == 0){ // QUIT
-            usleep(delay * 50000); // convert to microseconds
+void *user_thread(void *arg){
+    int tid = *(int *)arg;  
+    free(arg);
 
-            pthread_mutex_lock(&rmtx);
+    const int *op = scn.ops[tid];
+    int nops = scn.nops[tid];
 
-            g_request = (Request *)malloc(sizeof(Request));
-            g_request->type = 2; // QUIT
-            g_request->thread_id = tid;
-            g_request->request = NULL;
+    // Wait for all threads to be ready
+    pthread_barrier_wait(&BOS);
+    
+    say("    Thread %d born\n", tid);
 
-            pthread_barrier_wait(&REQB);
+    // Process each request of the thread's script
+    for(int k = 0; k < nops; k++, op += SCN_OP_INTS(m)){
+        int delay = op[0];
 
-            pthread_barrier_wait(&ACKB[tid]);
+        if(op[1] == SCN_QUIT){ // QUIT
+            usleep(delay * DELAY_UNIT); // convert to microseconds
 
-            pthread_mutex_lock(&pmtx);
-            printf("    Thread %d going to quit\n", tid);
-            fflush(stdout);
-            pthread_mutex_unlock(&pmtx);
+            trace_record(&utrace[tid], TR_SUBMIT, tid, 2);
+            ring_push(&shards[0].ring, 2, tid, NULL, 0);
+            wait_for_master(tid); // resources released
 
-            pthread_mutex_unlock(&rmtx);
+            say("    Thread %d going to quit\n", tid);
             break;
         }
         else{ // resource request
-            int ri = 0; // request index
+            const int *request = op + 2;
             bool is_add = false;
-            int *request = (int *)calloc(MAX_RESOURCES, sizeof(int));
-            if (!request) {
-                perror("Failed to allocate memory for request");
-                continue;
-            }
-
-            // Parse remaining resource values
-            while((token = strtok_r(NULL, " \t", &saveptr)) && ri < MAX_RESOURCES){
-                request[ri++] = atoi(token);
-                if(atoi(token) > 0){
+            for(int j = 0; j < m; j++){
+                if(request[j] > 0){
                     is_add = true;
                 }
             }
 
             // Wait for specified delay to send this request
-            usleep(delay * 50000); // convert to microseconds
+            usleep(delay * DELAY_UNIT); // convert to microseconds
             
-            // Send the request -> store in global request
-            pthread_mutex_lock(&rmtx);
-
-            g_request = (Request *)malloc(sizeof(Request));
-            g_request->type = is_add ? 1 : 0; // 1 for ADDITIONAL, 0 for RELEASE
-            g_request->thread_id = tid;
-            g_request->request = (int *)calloc(MAX_RESOURCES, sizeof(int));
-            if (!g_request->request) {
-                perror("Failed to allocate memory for g_request->request");
-                free(request);
-                free(g_request);
-                pthread_mutex_unlock(&rmtx);
-                continue;
+            // Send the request to the master
+            uint64_t t0 = clock_ns();
+            int home = 0; // shard of the first resource involved
+            for(int j = 0; j < m; j++){
+                if(request[j] != 0){
+                    home = shard_of[j];
+                    break;
+                }
             }
-            
-            for(int i = 0; i < ri; i++){
-                g_request->request[i] = request[i];
+            trace_record(&utrace[tid], TR_SUBMIT, tid, is_add ? 1 : 0);
+            ring_push(&shards[home].ring, is_add ? 1 : 0, tid, request, m); // 1 for ADDITIONAL, 0 for RELEASE
+
+            say("    Thread %d sends resource request: type = %s\n", tid, is_add ? "ADDITIONAL" : "RELEASE");
+
+            // ADDITIONAL: wait for the grant, RELEASE: wait until it is applied
+            wait_for_master(tid);
+
+            if(aborted[tid]){
+                say("    Thread %d is aborted\n", tid);
+                break;
             }
-            
-            // Free local request
-            free(request);
+            else if(is_add){
+                hist_record(&grant_hist[tid], clock_ns() - t0);
+                say("    Thread %d is granted its last resource request\n", tid);
+            }
+            else{
+                say("    Thread %d is done with its resource release request\n", tid);
+            }
+        }
+    }
 
-            if(is_add) pthread_mutex_lock(&cmtx[tid]);
+    return NULL;
+}
 
-            pthread_barrier_wait(&REQB); // Inform master
+// Map scenario.bin. Returns 1 if loaded, 0 if there is no such file, -1 if it is invalid.
+int load_binary(const char *path){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return 0;
+    struct stat st;
+    if(fstat(fd, &st) < 0){
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    size_t len = (size_t)st.st_size;
+    void *map = (len >= sizeof(scn_header)) ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(map == MAP_FAILED){
+        fprintf(stderr, "Cannot map %s\n", path);
+        return -1;
+    }
 
-            pthread_mutex_lock(&pmtx);
-            printf("    Thread %d sends resource request: type = %s\n", tid, is_add ? "ADDITIONAL" : "RELEASE");
-            fflush(stdout);
-            pthread_mutex_unlock(&pmtx);
+    const scn_header *h = (const scn_header *)map;
+    m = h->m;
+    n = h->n;
+    const int64_t *start = (const int64_t *)(h + 1);
+    size_t ops_at = sizeof(scn_header) + (n + 1) * sizeof(int64_t) + ((size_t)m + (size_t)n * m) * sizeof(int32_t);
+    if(memcmp(h->magic, SCN_MAGIC, sizeof(h->magic)) != 0 || m <= 0 || n <= 0 || ops_at > len ||
+       start[0] != 0 || ops_at + start[n] * SCN_OP_INTS(m) * sizeof(int32_t) != len){
+        fprintf(stderr, "%s is not a valid scenario file\n", path);
+        munmap(map, len);
+        return -1;
+    }
 
-            pthread_barrier_wait(&ACKB[tid]); // Wait for master to acknowledge
-            pthread_mutex_unlock(&rmtx); // Release resource mutex
-            
+    scn.map = map;
+    scn.map_len = len;
+    scn.avail = (const int *)(start + n + 1);
+    scn.max = scn.avail + m;
+    const int *ops = scn.max + (size_t)n * m;
+    scn.ops = (const int **)malloc(n * sizeof(int *));
+    scn.nops = (int *)malloc(n * sizeof(int));
+    for(int t = 0; t < n; t++){
+        scn.ops[t] = ops + start[t] * SCN_OP_INTS(m);
+        scn.nops[t] = (int)(start[t + 1] - start[t]);
+    }
+    return 1;
+}
 
-            // If request is ADDITIONAL, wait for it to be granted
-            if(is_add){
-                pthread_cond_wait(&cv[tid], &cmtx[tid]);
+// Parse an int at *p, skipping blanks but not newlines
+static bool next_int(const char **p, int *v){
+    const char *q = *p;
+    while(*q == ' ' || *q == '\t' || *q == '\r') q++;
+    if(!(*q >= '0' && *q <= '9') && *q != '-' && *q != '+') return false; // strtol would skip newlines
+    char *end;
+    long x = strtol(q, &end, 10);
+    if(end == q) return false;
+    *v = (int)x;
+    *p = end;
+    return true;
+}
 
-                pthread_mutex_lock(&pmtx);
-                printf("    Thread %d is granted its last resource request\n", tid);
-                fflush(stdout);
-                pthread_mutex_unlock(&pmtx);
+// Parse input/threadNN.txt: the MAX line, then "delay R values" lines and "delay Q"
+bool parse_thread_file(int t){
+    char filename[PATH_MAX];
+    snprintf(filename, sizeof(filename), "%s/thread%02d.txt", input_dir, t);
+    char *text = read_file(filename);
+    if(!text){
+        perror("Error opening thread file");
+        return false;
+    }
 
-                pthread_mutex_unlock(&cmtx[tid]);
-            }
-            else{
-                pthread_mutex_lock(&pmtx);
-                printf("    Thread %d is done with its resource release request\n", tid);
-                fflush(stdout);
-                pthread_mutex_unlock(&pmtx);
+    const char *p = text;
+    for(int j = 0; j < m; j++){
+        while(*p == '\n') p++;
+        if(!next_int(&p, &scn.text_max[(size_t)t * m + j])){
+            fprintf(stderr, "Error reading from thread file %s\n", filename);
+            free(text);
+            return false;
+        }
+    }
+
+    std::vector<int> &ops = scn.text_ops[t];
+    while(*p){
+        const char *eol = strchr(p, '\n');
+        if(!eol) eol = p + strlen(p);
+        int delay;
+        if(next_int(&p, &delay) && p < eol){
+            while(*p == ' ' || *p == '\t') p++;
+            const char *word = p; // type of the line
+            while(p < eol && *p != ' ' && *p != '\t' && *p != '\r') p++;
+            if(p > word){
+                size_t at = ops.size();
+                ops.resize(at + SCN_OP_INTS(m), 0);
+                ops[at] = delay;
+                if(p - word == 1 && *word == 'Q'){
+                    ops[at + 1] = SCN_QUIT;
+                }
+                else{
+                    ops[at + 1] = SCN_REQUEST;
+                    for(int j = 0; j < m && p < eol && next_int(&p, &ops[at + 2 + j]); j++);
+                }
             }
         }
+        p = *eol ? eol + 1 : eol;
     }
+    free(text);
+    return true;
+}
 
-    // Free the line buffer allocated by getline()
-    free(line);
-    fclose(thread_file);
+// Loader thread: parse the thread files first..last-1
+void *load_thread_files(void *arg){
+    int *range = (int *)arg;
+    for(int t = range[0]; t < range[1] && !load_failed; t++){
+        if(!parse_thread_file(t)) load_failed = true;
+    }
     return NULL;
 }
 
-void printQ(std::queue<local_request> &Q){
-    printf("        Waiting thereads: ");
-    std::queue<local_request> tempQ = Q;
-    while(!tempQ.empty()){
-        local_request lr = tempQ.front();
-        tempQ.pop();
-        printf("%d ", lr.thread_id);
+// Import system.txt and the thread files, the files parsed in parallel
+bool load_text(){
+    char filename[PATH_MAX];
+    snprintf(filename, sizeof(filename), "%s/system.txt", input_dir);
+    FILE *system_file = fopen(filename, "r");
+    if (!system_file) {
+        perror("Error opening system.txt");
+        return false;
     }
-    printf("\n");
-    fflush(stdout);
+
+    if(fscanf(system_file, "%d %d", &m, &n) != 2 || m <= 0 || n <= 0){
+        fprintf(stderr, "Invalid number of resource types or threads\n");
+        fclose(system_file);
+        return false;
+    }
+
+    scn.text_avail = (int *)malloc(m * sizeof(int));
+    for (int i = 0; i < m; i++) {
+        if (fscanf(system_file, "%d", &scn.text_avail[i]) != 1) {
+            fprintf(stderr, "Error reading available resources\n");
+            fclose(system_file);
+            return false;
+        }
+    }
+    fclose(system_file);
+
+    scn.text_max = (int *)calloc((size_t)n * m, sizeof(int));
+    scn.text_ops = new std::vector<int>[n];
+    int loaders = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (loaders > n) loaders = n;
+    if (loaders < 1) loaders = 1;
+    pthread_t *tids = (pthread_t *)malloc(loaders * sizeof(pthread_t));
+    int *ranges = (int *)malloc(2 * loaders * sizeof(int));
+    for (int k = 0; k < loaders; k++) {
+        ranges[2 * k] = (int)((long)n * k / loaders);
+        ranges[2 * k + 1] = (int)((long)n * (k + 1) / loaders);
+        pthread_create(&tids[k], NULL, load_thread_files, &ranges[2 * k]);
+    }
+    for (int k = 0; k < loaders; k++) {
+        pthread_join(tids[k], NULL);
+    }
+    free(tids);
+    free(ranges);
+    if (load_failed) {
+        return false;
+    }
+
+    scn.avail = scn.text_avail;
+    scn.max = scn.text_max;
+    scn.ops = (const int **)malloc(n * sizeof(int *));
+    scn.nops = (int *)malloc(n * sizeof(int));
+    for (int t = 0; t < n; t++) {
+        scn.ops[t] = scn.text_ops[t].data();
+        scn.nops[t] = (int)(scn.text_ops[t].size() / SCN_OP_INTS(m));
+    }
+    return true;
+}
+
+void free_scenario(){
+    if (scn.map) munmap(scn.map, scn.map_len);
+    free(scn.text_avail);
+    free(scn.text_max);
+    delete[] scn.text_ops;
+    free(scn.ops);
+    free(scn.nops);
+}
+
+// Whole file as a NUL-terminated string, NULL if it cannot be read
+char *read_file(const char *path){
+    FILE *fp = fopen(path, "r");
+    if(!fp) return NULL;
+    size_t cap = 4096, len = 0, got;
+    char *buf = (char *)malloc(cap);
+    while((got = fread(buf + len, 1, cap - len - 1, fp)) > 0){
+        len += got;
+        if(cap - len == 1){
+            cap *= 2;
+            buf = (char *)realloc(buf, cap);
+        }
+    }
+    buf[len] = '\0';
+    fclose(fp);
+    return buf;
 }
 
-void process_pending_requests(std::queue<local_request> &Q, int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads) {
-    std::queue<local_request> temp_queue, fulfilled_queue;
+double now_ms(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
 
+// One line of the simulation log, printed whole under pmtx; nothing with -q
+void say(const char *fmt, ...){
+    if(quiet) return;
+    va_list ap;
+    va_start(ap, fmt);
     pthread_mutex_lock(&pmtx);
-    printQ(Q);    
-    printf("Master thread tries to grant pending requests\n");
+    vprintf(fmt, ap);
     fflush(stdout);
     pthread_mutex_unlock(&pmtx);
+    va_end(ap);
+}
 
-    // process all requests in the queue
-    while(!Q.empty()){
-        local_request lr = Q.front();
-        Q.pop();
+// Latency of ADDITIONAL requests, from sending to being granted
+void print_stats(){
+    LatHist *all = (LatHist *)calloc(1, sizeof(LatHist));
+    printf("+++ %d threads, %d resource types, %s grant policy\n", n, m, policy_names[policy]);
+    for(int i = 0; i < n; i++){
+        LatHist *h = &grant_hist[i];
+        if(h->count == 0) continue;
+        printf("    Thread %d: %lu grants, wait p50 %.3f ms, p99 %.3f ms\n",
+               i, (unsigned long)h->count, hist_quantile(h, 0.5) / 1e6, hist_quantile(h, 0.99) / 1e6);
+        hist_merge(all, h);
+    }
+    if(all->count > 0){
+        printf("    Grant latency over %lu requests: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n",
+               (unsigned long)all->count, all->sum / all->count / 1e6, hist_quantile(all, 0.5) / 1e6,
+               hist_quantile(all, 0.99) / 1e6, hist_quantile(all, 0.999) / 1e6, all->max / 1e6);
+    }
+    printf("    Safety checks: %ld fast, %ld resumed, %ld full\n", fast_checks, resumed_checks, full_checks);
 
-        int thread_id = lr.thread_id;
-        int *request = lr.req;
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("    Context switches: %ld voluntary, %ld involuntary (%.2f per grant)\n",
+           ru.ru_nvcsw, ru.ru_nivcsw, all->count ? (double)(ru.ru_nvcsw + ru.ru_nivcsw) / all->count : 0.0);
+    fflush(stdout);
+    free(all);
+}
 
-        // Only process requests for active threads
-        if (!active_threads[thread_id]) {
+// Write the events of every user thread and master, merged in time order, one per line:
+//   ns  source  event  thread  arg
+// where source is Tk for user thread k and Ms for the master of shard s
+bool dump_trace(const char *path){
+    struct Entry { const TraceEvent *e; int src; }; // src < 0: master -src-1
+    std::vector<Entry> all;
+    unsigned long dropped = 0;
+    for(int i = -nshards; i < n; i++){
+        TraceBuf *b = (i < 0) ? &shards[-i - 1].trace : &utrace[i];
+        for(unsigned long k = 0; k < trace_count(b); k++){
+            all.push_back(Entry{ trace_at(b, k), i });
+        }
+        dropped += b->head - trace_count(b);
+    }
+    std::stable_sort(all.begin(), all.end(), [](const Entry &a, const Entry &b){ return a.e->ns < b.e->ns; });
+
+    FILE *fp = fopen(path, "w");
+    if(!fp) return false;
+    fprintf(fp, "# ns source event thread arg (%zu events, %lu overwritten)\n", all.size(), dropped);
+    for(const Entry &x : all){
+        fprintf(fp, "%llu %c%d %s %d %d\n", (unsigned long long)x.e->ns, x.src < 0 ? 'M' : 'T',
+                x.src < 0 ? -x.src - 1 : x.src, trace_names[x.e->type], x.e->thread, x.e->arg);
+    }
+    return fclose(fp) == 0;
+}
+
+// Pending requests held by the calling shard
+void printQ(){
+    printf("        Waiting thereads: ");
+    for(int t = 0; t < n; t++){
+        if(self->owns[t]){
+            printf("%d ", t);
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+// Resource j was released (the caller holds its shard): its blocked requests,
+// and the unsafe ones, may now be grantable. Requests held by other shards are
+// handed back to them with a RECHECK.
+void wake_blocked(int j){
+    for(int t : blocked_on[j]){
+        int h = pending[t].home;
+        if(h == self->id) self->cand.push_back(t);
+        else ring_push(&shards[h].ring, REQ_RECHECK, t, NULL, 0);
+    }
+    blocked_on[j].clear();
+    self->cand.insert(self->cand.end(), self->unsafe_wait.begin(), self->unsafe_wait.end());
+    self->unsafe_wait.clear();
+#ifdef _DLAVOID
+    for(int s = 0; s < nshards; s++){
+        if(s != self->id && !shards[s].recheck_unsafe.exchange(true)){
+            ring_push(&shards[s].ring, REQ_RECHECK, -1, NULL, 0);
+        }
+    }
+#endif
+}
+
+// Sort key of a pending request under the grant policy; lower is tried first
+double policy_key(int t, double now, int m, int **ALLOC){
+    pending_t *p = &pending[t];
+    switch(policy){
+        case POLICY_SMALL:
+            return p->size;
+        case POLICY_AGING: // one instance less for every delay unit waited
+            return p->size - (now - p->since) * 1000.0 / DELAY_UNIT;
+        case POLICY_FAIR: { // fewest instances held
+            int held = 0;
+            for(int j = 0; j < m; j++) held += ALLOC[t][j];
+            return held;
+        }
+        default:
+            return p->seq;
+    }
+}
+
+void process_pending_requests(int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads) {
+    Shard *sh = self;
+    std::vector<std::pair<std::pair<double, long>, int> > &order = sh->order;
+    std::vector<int> &granted = sh->granted;
+
+    // nothing was released and nothing arrived: no pending request can be granted
+    sh->blocked_now = false;
+    if(sh->cand.empty()){
+        return;
+    }
+
+    if(!quiet){
+        pthread_mutex_lock(&pmtx);
+        printQ();
+        printf("Master thread tries to grant pending requests\n");
+        fflush(stdout);
+        pthread_mutex_unlock(&pmtx);
+    }
+
+    // try the candidates in policy order, ties by arrival
+    double now = now_ms();
+    order.clear();
+    for(int t : sh->cand){
+        order.push_back(std::make_pair(std::make_pair(policy_key(t, now, m, ALLOC), pending[t].seq), t));
+    }
+    sh->cand.clear();
+    std::sort(order.begin(), order.end());
+
+    granted.clear();
+    for(size_t k = 0; k < order.size(); k++){
+        int thread_id = order[k].second;
+        local_request lr;
+        lr.thread_id = thread_id;
+        lr.req = pending[thread_id].req;
+
+        // Only process requests for active threads (an aborted thread may still be indexed)
+        if (!active_threads[thread_id] || !lr.req) {
             continue;
         }
 
-        if(can_fulfill_req(lr, m, n, ALLOC, NEED, AVAILABLE, active_threads)){
+        // phase one: lock the shards involved and check; phase two: commit
+#ifdef _DLAVOID
+        lock_shards(NULL); // the safety check reads every column
+#else
+        lock_shards(lr.req);
+#endif
+        int blocking;
+        if(can_fulfill_req(lr, m, n, ALLOC, NEED, AVAILABLE, active_threads, &blocking)){
             // grant request
             for(int i = 0; i < m; i++){
-                AVAILABLE[i] -= request[i];
-                ALLOC[thread_id][i] += request[i];
-                NEED[thread_id][i] -= request[i];
+                if(lr.req[i] == 0) continue; // column of a shard that may not be locked
+                AVAILABLE[i] -= lr.req[i];
+                ALLOC[thread_id][i] += lr.req[i];
+                NEED[thread_id][i] -= lr.req[i];
             }
+            safe_dirty = true;
+            trace_record(&sh->trace, TR_GRANT, thread_id, 0);
 
-            pthread_mutex_lock(&pmtx);
-            printf("Master thread grants resource request for thread %d\n", thread_id);
-            fflush(stdout);
-            pthread_mutex_unlock(&pmtx);
+            say("Master thread grants resource request for thread %d\n", thread_id);
 
-            // store in fulfilled queue
-            fulfilled_queue.push(lr);
+            granted.push_back(thread_id);
+        }
+        else if(blocking >= 0){
+            blocked_on[blocking].push_back(thread_id);
+            sh->blocked_now = true;
         }
         else{
-            // cannot fulfill request, put it back in the queue
-            temp_queue.push(lr);
+            sh->unsafe_wait.push_back(thread_id);
+            sh->blocked_now = true;
         }
+        unlock_shards();
     }
 
-    // send cond signal to threads whose requests are granted
-    while(!fulfilled_queue.empty()){
-        local_request lr = fulfilled_queue.front();
-        fulfilled_queue.pop();
+    // signal the threads whose requests are granted
+    for(int thread_id : granted){
+        free(pending[thread_id].req);
+        pending[thread_id].req = NULL;
+        sh->owns[thread_id] = false;
+        notify_thread(thread_id);
+    }
+
+    if(!quiet){
+        pthread_mutex_lock(&pmtx);
+        printQ();
+        pthread_mutex_unlock(&pmtx);
+    }
+}
+
+// Deadlock detection over the pending set. A thread without a pending request is
+// not blocked, so it is assumed to run to completion and return what it holds; a
+// blocked thread can then finish once its request fits in work. For every resource
+// the blocked threads short of it are sorted by their request, and a pointer moves
+// along that list as work grows, so each (thread, resource) pair is visited once:
+// O(n m) plus the sorts. Marks the threads that can never finish in dl and returns
+// how many there are.
+int detect_deadlock(int m, int n, int **ALLOC, int *AVAILABLE, bool *active_threads, bool *dl){
+    static std::vector<int> *shortof; // per resource, blocked threads asking for more than work
+    static std::vector<int> ready;
+    static int *unmet; // per thread, resources it is still short of
+    static size_t *next; // per resource, position in shortof
+    if(!shortof){
+        shortof = new std::vector<int>[m];
+        unmet = (int *)malloc(n * sizeof(int));
+        next = (size_t *)malloc(m * sizeof(size_t));
+    }
+
+    for(int j = 0; j < m; j++){
+        work[j] = AVAILABLE[j];
+        shortof[j].clear();
+        next[j] = 0;
+    }
+    ready.clear();
+    for(int t = 0; t < n; t++){
+        dl[t] = false;
+        if(!active_threads[t]) continue;
+        unmet[t] = 0;
+        if(pending[t].req){
+            for(int j = 0; j < m; j++){
+                if(pending[t].req[j] > work[j]){
+                    shortof[j].push_back(t);
+                    unmet[t]++;
+                }
+            }
+        }
+        if(unmet[t] == 0) ready.push_back(t);
+    }
+    for(int j = 0; j < m; j++){
+        std::sort(shortof[j].begin(), shortof[j].end(),
+                  [j](int a, int b){ return pending[a].req[j] < pending[b].req[j]; });
+    }
 
-        int thread_id = lr.thread_id;
-        int *request = lr.req;
-        // free request
-        if(request){
-            free(request);
+    // let the threads that can finish return their resources
+    while(!ready.empty()){
+        int t = ready.back();
+        ready.pop_back();
+        for(int j = 0; j < m; j++){
+            if(ALLOC[t][j] == 0) continue;
+            work[j] += ALLOC[t][j];
+            std::vector<int> &v = shortof[j];
+            while(next[j] < v.size() && pending[v[next[j]]].req[j] <= work[j]){
+                if(--unmet[v[next[j]]] == 0) ready.push_back(v[next[j]]);
+                next[j]++;
+            }
         }
+    }
 
-        pthread_mutex_lock(&cmtx[thread_id]);
-        pthread_cond_signal(&cv[thread_id]);
-        pthread_mutex_unlock(&cmtx[thread_id]);
+    int count = 0;
+    for(int t = 0; t < n; t++){
+        if(active_threads[t] && unmet[t] > 0){
+            dl[t] = true;
+            count++;
+        }
     }
+    safe_dirty = true; // work was overwritten
+    return count;
+}
 
-    // put back pending requests
-    Q = temp_queue;
-    pthread_mutex_lock(&pmtx);
-    printQ(Q);
-    fflush(stdout);
-    pthread_mutex_unlock(&pmtx);
+// Total instances held by thread t
+int held(int t, int m, int **ALLOC){
+    int h = 0;
+    for(int j = 0; j < m; j++) h += ALLOC[t][j];
+    return h;
 }
 
-// Check if the system is in a safe state
-bool is_safe_state(int m, int n, int ** ALLOC, int ** NEED, int * AVAILABLE, bool * active_threads) {
-    // Work array and finished array
-    int work[m];
-    bool finish[n];
-    
+// Report a new deadlock; with a victim policy, abort victims until none is left.
+// Returns the number of threads aborted.
+int recover_deadlock(int m, int n, int **ALLOC, int **NEED, int **MAX_NEED, int *AVAILABLE, bool *active_threads){
+    static bool *dl;
+    if(!dl) dl = (bool *)malloc(n * sizeof(bool));
+    int aborts = 0, count;
+
+    while((count = detect_deadlock(m, n, ALLOC, AVAILABLE, active_threads, dl)) > 0){
+        if(memcmp(dl, deadlocked, n * sizeof(bool)) != 0){
+            memcpy(deadlocked, dl, n * sizeof(bool));
+            if(!quiet){
+                pthread_mutex_lock(&pmtx);
+                printf("+++ Deadlock detected among threads: ");
+                for(int t = 0; t < n; t++){
+                    if(dl[t]) printf("%d ", t);
+                }
+                printf("\n");
+                fflush(stdout);
+                pthread_mutex_unlock(&pmtx);
+            }
+        }
+        if(victim_policy == VICTIM_NONE) break;
+
+        // choose the victim among the deadlocked threads
+        int victim = -1;
+        for(int t = 0; t < n; t++){
+            if(!dl[t]) continue;
+            if(victim < 0 ||
+               (victim_policy == VICTIM_MINALLOC && held(t, m, ALLOC) < held(victim, m, ALLOC)) ||
+               (victim_policy == VICTIM_MAXALLOC && held(t, m, ALLOC) > held(victim, m, ALLOC)) ||
+               (victim_policy == VICTIM_LATEST && pending[t].seq > pending[victim].seq)){
+                victim = t;
+            }
+        }
+
+        // abort it: take back everything it holds and drop its request
+        for(int j = 0; j < m; j++){
+            if(ALLOC[victim][j] > 0) wake_blocked(j);
+            AVAILABLE[j] += ALLOC[victim][j];
+            ALLOC[victim][j] = 0;
+            NEED[victim][j] = MAX_NEED[victim][j];
+        }
+        free(pending[victim].req);
+        pending[victim].req = NULL;
+        self->owns[victim] = false;
+        active_threads[victim] = 0;
+        aborted[victim] = true;
+        safe_dirty = true;
+        aborts++;
+        trace_record(&self->trace, TR_QUIT, victim, 1);
+
+        say("Master thread aborts thread %d (%s) and releases its resources\n", victim, victim_names[victim_policy]);
+        notify_thread(victim);
+
+        // the released resources may unblock others
+        process_pending_requests(m, n, ALLOC, NEED, AVAILABLE, active_threads);
+    }
+    if(count == 0){
+        memset(deadlocked, 0, n * sizeof(bool));
+    }
+    return aborts;
+}
+
+// rows x stride ints, zeroed, every row 64-byte aligned
+int *alloc_rows(int rows) {
+    void *p;
+    if (posix_memalign(&p, 64, (size_t)rows * stride * sizeof(int)) != 0) {
+        perror("Error allocating matrix");
+        exit(1);
+    }
+    memset(p, 0, (size_t)rows * stride * sizeof(int));
+    return (int *)p;
+}
+
+// Row pointers into one contiguous block, so M[i][j] keeps working
+int **alloc_matrix(int rows) {
+    int **M = (int **)malloc(rows * sizeof(int *));
+    int *block = alloc_rows(rows);
+    for (int i = 0; i < rows; i++) {
+        M[i] = block + (size_t)i * stride;
+    }
+    return M;
+}
+
+void free_matrix(int **M) {
+    free(M[0]);
+    free(M);
+}
+
+// Row operations of the safety check over a padded row of stride ints.
+// With AVX2 (or SSE2) a 64-resource row is 8 (16) compares instead of 64.
+
+// true if need[j] <= work[j] for every j
+static inline bool row_fits(const int *need, const int *work) {
+#if defined(__AVX2__)
+    __m256i over = _mm256_setzero_si256();
+    for (int j = 0; j < stride; j += 8) {
+        __m256i nd = _mm256_load_si256((const __m256i *)(need + j));
+        __m256i wk = _mm256_load_si256((const __m256i *)(work + j));
+        over = _mm256_or_si256(over, _mm256_cmpgt_epi32(nd, wk));
+    }
+    return _mm256_testz_si256(over, over);
+#elif defined(__SSE2__)
+    __m128i over = _mm_setzero_si128();
+    for (int j = 0; j < stride; j += 4) {
+        __m128i nd = _mm_load_si128((const __m128i *)(need + j));
+        __m128i wk = _mm_load_si128((const __m128i *)(work + j));
+        over = _mm_or_si128(over, _mm_cmpgt_epi32(nd, wk));
+    }
+    return _mm_movemask_epi8(over) == 0;
+#else
+    for (int j = 0; j < stride; j++) {
+        if (need[j] > work[j]) return false;
+    }
+    return true;
+#endif
+}
+
+// work[j] += alloc[j]
+static inline void row_add(int *work, const int *alloc) {
+#if defined(__AVX2__)
+    for (int j = 0; j < stride; j += 8) {
+        __m256i wk = _mm256_load_si256((const __m256i *)(work + j));
+        __m256i al = _mm256_load_si256((const __m256i *)(alloc + j));
+        _mm256_store_si256((__m256i *)(work + j), _mm256_add_epi32(wk, al));
+    }
+#elif defined(__SSE2__)
+    for (int j = 0; j < stride; j += 4) {
+        __m128i wk = _mm_load_si128((const __m128i *)(work + j));
+        __m128i al = _mm_load_si128((const __m128i *)(alloc + j));
+        _mm_store_si128((__m128i *)(work + j), _mm_add_epi32(wk, al));
+    }
+#else
+    for (int j = 0; j < stride; j++) {
+        work[j] += alloc[j];
+    }
+#endif
+}
+
+// next[j] = min(low[j], work[j] - need[j]); false if some work[j] < need[j]
+static inline bool row_slack(int *next, const int *low, const int *work, const int *need) {
+#if defined(__AVX2__)
+    __m256i neg = _mm256_setzero_si256();
+    for (int j = 0; j < stride; j += 8) {
+        __m256i sur = _mm256_sub_epi32(_mm256_load_si256((const __m256i *)(work + j)),
+                                       _mm256_load_si256((const __m256i *)(need + j)));
+        __m256i lo = _mm256_load_si256((const __m256i *)(low + j));
+        neg = _mm256_or_si256(neg, sur);
+        _mm256_store_si256((__m256i *)(next + j), _mm256_min_epi32(sur, lo));
+    }
+    return _mm256_movemask_ps(_mm256_castsi256_ps(neg)) == 0;
+#elif defined(__SSE2__)
+    __m128i neg = _mm_setzero_si128();
+    for (int j = 0; j < stride; j += 4) {
+        __m128i sur = _mm_sub_epi32(_mm_load_si128((const __m128i *)(work + j)),
+                                    _mm_load_si128((const __m128i *)(need + j)));
+        __m128i lo = _mm_load_si128((const __m128i *)(low + j));
+        __m128i lt = _mm_cmplt_epi32(sur, lo);
+        neg = _mm_or_si128(neg, sur);
+        _mm_store_si128((__m128i *)(next + j),
+                        _mm_or_si128(_mm_and_si128(lt, sur), _mm_andnot_si128(lt, lo)));
+    }
+    return _mm_movemask_ps(_mm_castsi128_ps(neg)) == 0;
+#else
+    bool ok = true;
+    for (int j = 0; j < stride; j++) {
+        int surplus = work[j] - need[j];
+        if (surplus < 0) ok = false;
+        next[j] = (surplus < low[j]) ? surplus : low[j];
+    }
+    return ok;
+#endif
+}
+
+// Check if the system is in a safe state; if so, store a safe sequence in seq
+bool is_safe_state(int m, int n, int ** ALLOC, int ** NEED, int * AVAILABLE, bool * active_threads, int *seq, int *len) {
     // Initialize work = available
     for (int i = 0; i < m; i++) {
         work[i] = AVAILABLE[i];
@@ -538,26 +1331,18 @@ bool is_safe_state(int m, int n, int ** ALLOC, int ** NEED, int * AVAILABLE, boo
     
     // Find an unfinished thread that can complete
     bool found;
+    *len = 0;
     do {
         found = false;
         for (int i = 0; i < n; i++) {
             if (!finish[i]) {
                 // Check if thread i's needs can be satisfied
-                bool can_satisfy = true;
-                for (int j = 0; j < m; j++) {
-                    if (NEED[i][j] > work[j]) {
-                        can_satisfy = false;
-                        break;
-                    }
-                }
-                
-                if (can_satisfy) {
+                if (row_fits(NEED[i], work)) {
                     // Thread can finish, release its resources
-                    for (int j = 0; j < m; j++) {
-                        work[j] += ALLOC[i][j];
-                    }
+                    row_add(work, ALLOC[i]);
                     finish[i] = true;
                     found = true;
+                    seq[(*len)++] = i;
                 }
             }
         }
@@ -573,65 +1358,171 @@ bool is_safe_state(int m, int n, int ** ALLOC, int ** NEED, int * AVAILABLE, boo
     return true;
 }
 
-bool can_fulfill_req(local_request lr, int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads){
-    int thread_id = lr.thread_id;
-    int *request = lr.req;
-    // First check if request exceeds need or available
-    for(int i = 0; i < m; i++){
-        if(request[i] > NEED[thread_id][i] || request[i] > AVAILABLE[i]){
-            pthread_mutex_lock(&pmtx);
-            
-            printf("    +++ Insufficient resources to grant request of thread %d\n", thread_id);
-            fflush(stdout);
-            pthread_mutex_unlock(&pmtx);
+// Walk safe_seq in the current state, filling seq_pos and slack.
+// Returns false if the sequence no longer lets every thread finish.
+bool walk_safe_sequence(int m, int n, int **ALLOC, int **NEED, int *AVAILABLE) {
+    int *low = slack; // row 0: nothing precedes the first thread
+    for (int j = 0; j < m; j++) {
+        work[j] = AVAILABLE[j];
+        low[j] = INT_MAX;
+    }
+    for (int i = 0; i < n; i++) {
+        seq_pos[i] = -1;
+    }
+
+    for (int k = 0; k < safe_len; k++) {
+        int i = safe_seq[k];
+        int *next = slack + (size_t)(k + 1) * stride;
+        if (!row_slack(next, low, work, NEED[i])) {
             return false;
         }
+        row_add(work, ALLOC[i]);
+        seq_pos[i] = k;
+        low = next;
+    }
+    return true;
+}
+
+// Bring safe_seq and slack up to date after ALLOC/NEED/AVAILABLE changed.
+// Releases and grants made through the sequence keep it valid, so normally
+// this is one O(n*m) walk; only if the walk fails is a new sequence searched.
+void refresh_safe_sequence(int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads) {
+    safe_dirty = false;
+    if (safe_len >= 0) {
+        // drop threads that have quit
+        int len = 0;
+        for (int k = 0; k < safe_len; k++) {
+            if (active_threads[safe_seq[k]]) safe_seq[len++] = safe_seq[k];
+        }
+        safe_len = len;
+        if (walk_safe_sequence(m, n, ALLOC, NEED, AVAILABLE)) return;
     }
+    if (is_safe_state(m, n, ALLOC, NEED, AVAILABLE, active_threads, safe_seq, &safe_len) &&
+        walk_safe_sequence(m, n, ALLOC, NEED, AVAILABLE)) {
+        return;
+    }
+    safe_len = -1; // current state unsafe: no sequence to reuse
+}
 
-#ifdef _DLAVOID
-    // Temporarily allocate resources to check safety
-    int temp_available[m];
-    int **temp_alloc = (int **)malloc(n * sizeof(int *));
-    int **temp_need = (int **)malloc(n * sizeof(int *));
-    
-    // Make copies of allocation and need matrices
-    for (int i = 0; i < n; i++) {
-        temp_alloc[i] = (int *)malloc(m * sizeof(int));
-        temp_need[i] = (int *)malloc(m * sizeof(int));
-        
+// Safety check of the current state that starts from the last safe sequence: its
+// threads are kept in order as long as each can finish, and only the rest are
+// searched for, in their old order first. Finishing a thread only adds to work,
+// so once no remaining thread can finish, no other order would get further:
+// the answer is the same as is_safe_state()'s. Threads only ever become
+// inactive, so the sequence holds every active thread.
+bool resume_safe_sequence(int m, int **ALLOC, int **NEED, int *AVAILABLE, int *seq, int *len) {
+    for (int j = 0; j < m; j++) {
+        work[j] = AVAILABLE[j];
+    }
+    *len = 0;
+    int k = 0;
+    for (; k < safe_len; k++) {
+        int i = safe_seq[k];
+        if (!row_fits(NEED[i], work)) break;
+        row_add(work, ALLOC[i]);
+        seq[(*len)++] = i;
+    }
+
+    // Passes over the rest; the first reads it from safe_seq, which must stay intact
+    const int *from = safe_seq + k;
+    int rest = safe_len - k;
+    bool found = true;
+    while (rest > 0 && found) {
+        found = false;
+        int kept = 0;
+        for (int r = 0; r < rest; r++) {
+            int i = from[r];
+            if (row_fits(NEED[i], work)) {
+                row_add(work, ALLOC[i]);
+                seq[(*len)++] = i;
+                found = true;
+            } else {
+                pending_seq[kept++] = i;
+            }
+        }
+        from = pending_seq;
+        rest = kept;
+    }
+    return rest == 0;
+}
+
+// Would the state stay safe if thread_id were granted request (request <= NEED, AVAILABLE)?
+// With thread_id at position p of the last safe sequence, taking request away from
+// work only matters to the threads before p: after thread_id finishes, work is the
+// same as before. So the sequence still works iff request <= slack row p, an O(m)
+// test. Otherwise the state with the request applied in place (and undone) is
+// checked by resuming the last safe sequence from where it first fails, or with
+// the full check if there is none; a sequence found is kept, since the caller then grants.
+bool request_is_safe(int thread_id, int *request, int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads) {
+    if (safe_dirty) {
+        refresh_safe_sequence(m, n, ALLOC, NEED, AVAILABLE, active_threads);
+    }
+    if (safe_len >= 0 && seq_pos[thread_id] >= 0) {
+        int *low = slack + (size_t)seq_pos[thread_id] * stride;
+        bool fits = true;
         for (int j = 0; j < m; j++) {
-            temp_alloc[i][j] = ALLOC[i][j];
-            temp_need[i][j] = NEED[i][j];
+            if (request[j] > low[j]) {
+                fits = false;
+                break;
+            }
+        }
+        if (fits) {
+            fast_checks++;
+            return true;
         }
     }
-    
-    // Make copy of available resources
-    for (int i = 0; i < m; i++) {
-        temp_available[i] = AVAILABLE[i] - request[i];
+
+    for (int j = 0; j < m; j++) {
+        AVAILABLE[j] -= request[j];
+        ALLOC[thread_id][j] += request[j];
+        NEED[thread_id][j] -= request[j];
     }
-    
-    // Apply the request to the temporary state
-    for (int i = 0; i < m; i++) {
-        temp_alloc[thread_id][i] += request[i];
-        temp_need[thread_id][i] -= request[i];
+    int len;
+    bool safe;
+    if (safe_len >= 0) {
+        resumed_checks++;
+        safe = resume_safe_sequence(m, ALLOC, NEED, AVAILABLE, cand_seq, &len);
+    } else {
+        full_checks++;
+        safe = is_safe_state(m, n, ALLOC, NEED, AVAILABLE, active_threads, cand_seq, &len);
     }
-    
-    // Check if resulting state is safe
-    bool is_safe = is_safe_state(m, n, temp_alloc, temp_need, temp_available, active_threads);
-    
-    // Free temporary arrays
-    for (int i = 0; i < n; i++) {
-        free(temp_alloc[i]);
-        free(temp_need[i]);
+    for (int j = 0; j < m; j++) {
+        AVAILABLE[j] += request[j];
+        ALLOC[thread_id][j] -= request[j];
+        NEED[thread_id][j] += request[j];
     }
-    free(temp_alloc);
-    free(temp_need);
+
+    if (safe) {
+        int *tmp = safe_seq;
+        safe_seq = cand_seq;
+        cand_seq = tmp;
+        safe_len = len;
+        safe_dirty = true;
+    }
+    return safe;
+}
+
+// On failure, *blocking is the resource that is short, or -1 if the grant would be unsafe
+bool can_fulfill_req(local_request lr, int m, int n, int **ALLOC, int **NEED, int *AVAILABLE, bool *active_threads, int *blocking){
+    int thread_id = lr.thread_id;
+    int *request = lr.req;
+    // First check if request exceeds need or available
+    for(int i = 0; i < m; i++){
+        if(request[i] == 0) continue; // column of a shard that may not be locked
+        if(request[i] > NEED[thread_id][i] || request[i] > AVAILABLE[i]){
+            *blocking = i;
+            say("    +++ Insufficient resources to grant request of thread %d\n", thread_id);
+            return false;
+        }
+    }
+
+#ifdef _DLAVOID
+    // Check if the state after granting is safe
+    bool is_safe = request_is_safe(thread_id, request, m, n, ALLOC, NEED, AVAILABLE, active_threads);
 
     if(!is_safe){
-        pthread_mutex_lock(&pmtx);
-        printf("    +++ Unsafe to grant request of thread %d\n", thread_id);
-        fflush(stdout);
-        pthread_mutex_unlock(&pmtx);
+        *blocking = -1;
+        say("    +++ Unsafe to grant request of thread %d\n", thread_id);
     }
     
     return is_safe;
@@ -0,0 +1,32 @@
+#ifndef SCENARIO_H_
+#define SCENARIO_H_
+
+/*
+   Packed binary scenario (input/scenario.bin), written by geninput -b and
+   mapped read-only by resource. All fields are native-endian:
+
+      char    magic[8]           SCN_MAGIC
+      int32   m, n
+      int64   start[n + 1]       thread t owns ops start[t] .. start[t+1]-1
+      int32   AVAILABLE[m]
+      int32   MAX[n][m]
+      int32   ops[][SCN_OP_INTS] one per line of a thread file after MAX
+
+   An op is { delay, kind, req[0..m-1] }; kind is SCN_REQUEST for an "R" line
+   (req holds the line's values, zero-filled) and SCN_QUIT for the final "Q".
+*/
+
+#include <stdint.h>
+
+#define SCN_FILE "scenario.bin"
+#define SCN_MAGIC "LA8SCN1"
+#define SCN_REQUEST 0
+#define SCN_QUIT 1
+#define SCN_OP_INTS(m) (2 + (m))
+
+typedef struct {
+   char magic[8];
+   int32_t m, n;
+} scn_header;
+
+#endif
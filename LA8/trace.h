@@ -0,0 +1,127 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+// Instrumentation that does not serialize the threads it observes.
+// TraceBuf: a ring of timestamped events with a single writer (one user thread
+// or one master), so recording is a store and an increment; when full, the
+// oldest events are overwritten. The buffers are read only after the writers
+// have been joined.
+// LatHist: a log-linear (HDR-style) histogram of nanosecond values. Values
+// below 2^HIST_SUB_BITS get a bucket each; above that, every power of two is
+// split into 2^(HIST_SUB_BITS-1) equal buckets, so a quantile is off by at
+// most 1/2^HIST_SUB_BITS of its value, in a few KB of fixed memory.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+enum { TR_SUBMIT, TR_STORE, TR_GRANT, TR_RELEASE, TR_QUIT };
+static const char *trace_names[] = { "submit", "store", "grant", "release", "quit" };
+
+typedef struct {
+    uint64_t ns; // since trace_epoch
+    int32_t thread; // user thread the event is about
+    int16_t type; // TR_*
+    int16_t arg; // submit: request type; quit: 1 if aborted
+} TraceEvent;
+
+typedef struct {
+    TraceEvent *ev; // NULL while tracing is off
+    unsigned cap; // power of two
+    unsigned long head; // events recorded so far
+} TraceBuf;
+
+static uint64_t trace_epoch;
+
+static inline uint64_t clock_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// cap events (a power of two); ev is left NULL if cap is 0
+static inline void trace_init(TraceBuf *b, unsigned cap){
+    b->ev = cap ? (TraceEvent *)calloc(cap, sizeof(TraceEvent)) : NULL;
+    b->cap = cap;
+    b->head = 0;
+}
+
+static inline void trace_free(TraceBuf *b){
+    free(b->ev);
+    b->ev = NULL;
+}
+
+static inline void trace_record(TraceBuf *b, int type, int thread, int arg){
+    if(!b->ev) return;
+    TraceEvent *e = &b->ev[b->head++ & (b->cap - 1)];
+    e->ns = clock_ns() - trace_epoch;
+    e->thread = thread;
+    e->type = (int16_t)type;
+    e->arg = (int16_t)arg;
+}
+
+// Events still held, oldest first
+static inline unsigned long trace_count(const TraceBuf *b){
+    return b->head < b->cap ? b->head : b->cap;
+}
+
+static inline const TraceEvent *trace_at(const TraceBuf *b, unsigned long k){
+    return &b->ev[(b->head - trace_count(b) + k) & (b->cap - 1)];
+}
+
+#define HIST_SUB_BITS 5
+#define HIST_MAX_BIT 47 // larger values (over a day in ns) share the last bucket
+#define HIST_HALF (1 << (HIST_SUB_BITS - 1))
+#define HIST_BUCKETS ((HIST_MAX_BIT - HIST_SUB_BITS + 3) * HIST_HALF)
+
+typedef struct {
+    uint32_t counts[HIST_BUCKETS];
+    uint64_t count, max;
+    double sum;
+} LatHist;
+
+static inline int hist_index(uint64_t v){
+    if(v >= (uint64_t)1 << (HIST_MAX_BIT + 1)) v = ((uint64_t)1 << (HIST_MAX_BIT + 1)) - 1;
+    if(v < 2 * HIST_HALF) return (int)v;
+    int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS + 1;
+    return shift * HIST_HALF + (int)(v >> shift);
+}
+
+// Midpoint of bucket i
+static inline double hist_value(int i){
+    if(i < 2 * HIST_HALF) return i;
+    int shift = i / HIST_HALF - 1;
+    uint64_t low = (uint64_t)(i - shift * HIST_HALF) << shift;
+    return low + (double)((uint64_t)1 << shift) / 2;
+}
+
+static inline void hist_record(LatHist *h, uint64_t v){
+    h->counts[hist_index(v)]++;
+    h->count++;
+    h->sum += v;
+    if(v > h->max) h->max = v;
+}
+
+static inline void hist_merge(LatHist *into, const LatHist *h){
+    for(int i = 0; i < HIST_BUCKETS; i++) into->counts[i] += h->counts[i];
+    into->count += h->count;
+    into->sum += h->sum;
+    if(h->max > into->max) into->max = h->max;
+}
+
+// q-quantile, at most the largest value recorded
+static inline double hist_quantile(const LatHist *h, double q){
+    if(h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * h->count), seen = 0;
+    if(rank >= h->count) rank = h->count - 1;
+    for(int i = 0; i < HIST_BUCKETS; i++){
+        seen += h->counts[i];
+        if(seen > rank){
+            double v = hist_value(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+#endif
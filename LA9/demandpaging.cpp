@@ -1,6 +1,11 @@
 #include <queue>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std;
 
@@ -32,7 +37,8 @@ struct Process {
     int pid;                                        // process id
     int s;                                          // size of array A (number of integers)
     int m;                                          // number of searches to perform
-    int *keys;                                      // search keys (each search key is an index in A)
+    const char *keyPos;                             // next unread search key in the mapped search.txt
+    int key;                                        // key of the current search (an index in A)
     int currentSearch;                              // index of next search to perform
     uint16_t *pt;                                   // page table of size PAGE_TABLE_ENTRIES (each entry is 16-bit)
 };
@@ -42,14 +48,66 @@ void initproc(Process *proc, int id, int size, int searches) {
     proc->s = size;
     proc->m = searches;
     proc->currentSearch = 0;
-    proc->keys = (int *)malloc(searches * sizeof(int));
+    proc->keyPos = NULL;
+    proc->key = 0;
     proc->pt = (uint16_t *)malloc(PAGE_TABLE_ENTRIES * sizeof(uint16_t));
-    if (proc->keys == NULL || proc->pt == NULL) {
+    if (proc->pt == NULL) {
         fprintf(stderr, "Error: Memory allocation failed\n");
         exit(1);
     }
 }
 
+// search.txt is mapped read-only; keys are parsed from it one search at a time
+const char *inputData;
+const char *inputEnd;
+size_t inputSize;
+
+// Skip blanks and parse one non-negative integer from the mapped input.
+// Up to seven digits are converted at once with SWAR arithmetic on an 8-byte load.
+bool parseInt(const char *&pos, int &value) {
+    const char *p = pos;
+    while (p < inputEnd && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (inputEnd - p >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, p, 8);
+        uint64_t digits = chunk - 0x3030303030303030ULL;
+        uint64_t nonDigit = (digits | (digits + 0x0606060606060606ULL)) & 0xF0F0F0F0F0F0F0F0ULL;
+        int len = nonDigit ? __builtin_ctzll(nonDigit) / 8 : 8;
+        if (len == 0) return false;
+        if (len < 8) {
+            digits <<= (8 - len) * 8;
+            digits = (digits * 10 + (digits >> 8)) & 0x00FF00FF00FF00FFULL;
+            digits = (digits * 100 + (digits >> 16)) & 0x0000FFFF0000FFFFULL;
+            digits = (digits * 10000 + (digits >> 32)) & 0xFFFFFFFFULL;
+            value = (int)digits;
+            pos = p + len;
+            return true;
+        }
+    }
+#endif
+
+    if (p >= inputEnd || *p < '0' || *p > '9') return false;
+    int result = 0;
+    while (p < inputEnd && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    value = result;
+    pos = p;
+    return true;
+}
+
+// Load the key of the process's current search from its line in search.txt
+void nextKey(Process *proc) {
+    if (proc->currentSearch >= proc->m) return;
+    if (!parseInt(proc->keyPos, proc->key)) {
+        fprintf(stderr, "Error: Cannot read search key %d of process %d\n", proc->currentSearch, proc->pid);
+        exit(1);
+    }
+}
+
 // Global kernel data
 queue<int> readyQ;                                  // holds process ids of active processes (round robin)
 queue<int> swappedQ;                                // FIFO queue of swapped-out processes (store process id)
@@ -188,7 +246,7 @@ bool swapInNextProcess() {
     activeProcesses++;
     
     // Immediately perform a search after swapping in
-    int key = proc->keys[proc->currentSearch];
+    int key = proc->key;
     
     #ifdef VERBOSE
     printf("\tSearch %d by Process %d\n", proc->currentSearch+1, proc->pid);
@@ -202,6 +260,7 @@ bool swapInNextProcess() {
     } else {
         // Search completed successfully
         proc->currentSearch++;
+        nextKey(proc);
         
         // Check if process has more searches
         if (proc->currentSearch < proc->m) {
@@ -229,14 +288,31 @@ int main() {
     }
     cntff = USER_FRAMES;
 
-    // Read input from search.txt
-    FILE *fin = fopen("search.txt", "r");
-    if (!fin) {
+    // Map search.txt; only the array sizes are read now, keys are read lazily
+    int fd = open("search.txt", O_RDONLY);
+    if (fd < 0) {
+        perror("search.txt");
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "Error: search.txt is empty\n");
+        return 1;
+    }
+    inputSize = st.st_size;
+    inputData = (const char *)mmap(NULL, inputSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (inputData == MAP_FAILED) {
         perror("search.txt");
         return 1;
     }
+    inputEnd = inputData + inputSize;
 
-    fscanf(fin, "%d %d", &totalProcesses, &searchesPerProcess);
+    const char *pos = inputData;
+    if (!parseInt(pos, totalProcesses) || !parseInt(pos, searchesPerProcess)) {
+        fprintf(stderr, "Error: Cannot read process count and search count\n");
+        return 1;
+    }
 
     // Creating processes and initializing their page tables
     processes = (Process **)malloc(totalProcesses * sizeof(Process *));
@@ -246,7 +322,10 @@ int main() {
     }
     for (int i = 0; i < totalProcesses; i++) {
         int s;
-        fscanf(fin, "%d", &s);
+        if (!parseInt(pos, s)) {
+            fprintf(stderr, "Error: Cannot read array size of process %d\n", i);
+            return 1;
+        }
         Process *proc = (Process *)malloc(sizeof(Process));
         if (proc == NULL) {
             fprintf(stderr, "Error: Memory allocation failed\n");
@@ -254,12 +333,11 @@ int main() {
         }
         initproc(proc, i, s, searchesPerProcess);
         
-        // Read m search keys
-        for (int j = 0; j < searchesPerProcess; j++) {
-            int key;
-            fscanf(fin, "%d", &key);
-            proc->keys[j] = key;
-        }
+        // The m search keys follow on the same line: remember where, skip the line
+        proc->keyPos = pos;
+        nextKey(proc);
+        const char *eol = (const char *)memchr(pos, '\n', inputEnd - pos);
+        pos = eol ? eol + 1 : inputEnd;
         
         // Allocate essential pages (pages 0 to ESSENTIAL_PAGES-1)
         if (!allocateEssentialPages(proc)) {
@@ -270,7 +348,6 @@ int main() {
         readyQ.push(i);
         activeProcesses++;
     }
-    fclose(fin);
 
     printf("+++ Simulation data read from file\n");
     printf("+++ Kernel data initialized\n");
@@ -304,7 +381,7 @@ int main() {
         }
         
         // Simulate one binary search for the current search key
-        int key = proc->keys[proc->currentSearch];
+        int key = proc->key;
 
         #ifdef VERBOSE
         printf("\tSearch %d by Process %d\n", proc->currentSearch+1, pid);
@@ -319,6 +396,7 @@ int main() {
         } else {
             // Binary search finished successfully 
             proc->currentSearch++; // move to next search
+            nextKey(proc);
             
             // Check if process has more searches
             if (proc->currentSearch < proc->m) {
@@ -342,10 +420,10 @@ int main() {
 
     // Cleanup: free all process objects.
     for (int i = 0; i < totalProcesses; i++) {
-        free(processes[i]->keys);
         free(processes[i]->pt);
         free(processes[i]);
     }
     free(processes);
+    munmap((void *)inputData, inputSize);
     return 0;
 }